@@ -1,10 +1,31 @@
 #!/usr/bin/env python3
-import argparse, os, struct, time, glob, select, sys
+import argparse, os, struct, time, glob, select, sys, fcntl
+
+try:
+    import numpy as np  # optional: vectorised batch decode
+except ImportError:
+    np = None
 
 DEV = "/dev/simtemp"
+# layouts below follow kernel/nxp_simtemp.h, the driver's ABI header
 REC = struct.Struct("=Q i I")  # u64 ns, s32 mC, u32 flags (packed)
 FLAG_NEW = 1 << 0
 FLAG_THRESH = 1 << 1
+FLAG_OVERRUN = 1 << 2
+
+REC_V2 = struct.Struct("=Q I i I I")  # struct simtemp_sample_v2: ns, seq, mC, flags, reserved
+FORMAT_V2 = 1
+IOC_SET_FORMAT = (1 << 30) | (4 << 16) | (ord("S") << 8) | 6  # _IOW('S', 6, __u32)
+
+EVT = struct.Struct("=Q I i i I")  # struct simtemp_event: ns, seq, mC, threshold, flags
+EVT_RISING = 1 << 0
+EVT_OVERRUN = 1 << 1
+IOC_GET_EVENT = (2 << 30) | (EVT.size << 16) | (ord("S") << 8) | 1  # _IOR('S', 1, ...)
+
+WIN = struct.Struct("=Q Q i i i I I I")  # struct simtemp_window: start, end, min, max, mean, count, crossings, flags
+WIN_OVERRUN = 1 << 0
+STREAM_WINDOW = 1
+IOC_SET_STREAM = (1 << 30) | (4 << 16) | (ord("S") << 8) | 5  # _IOW('S', 5, __u32)
 
 
 def write_attr(base, name, value):
@@ -15,47 +36,187 @@ def write_attr(base, name, value):
     except Exception as e:
         print(f"[warn] sysfs {name}: {e}", file=sys.stderr)
 
+def print_event(fd):
+    # POLLPRI: exactly one event is guaranteed to be queued for us
+    raw = fcntl.ioctl(fd, IOC_GET_EVENT, bytes(EVT.size))
+    ts_ns, seq, temp_mC, thr_mC, flags = EVT.unpack(raw)
+    edge = "rising" if flags & EVT_RISING else "falling"
+    lost = " (events lost)" if flags & EVT_OVERRUN else ""
+    print(f"{ts_ns} event={edge} seq={seq} temp={temp_mC / 1000.0:.3f}C "
+          f"threshold={thr_mC / 1000.0:.3f}C{lost}")
+
+def print_window(data):
+    start, end, mn, mx, mean, count, crossings, flags = WIN.unpack(data)
+    lost = " (windows lost)" if flags & WIN_OVERRUN else ""
+    print(f"{start} window={(end - start) / 1e6:.1f}ms n={count} min={mn / 1000.0:.3f}C "
+          f"mean={mean / 1000.0:.3f}C max={mx / 1000.0:.3f}C crossings={crossings}{lost}")
+
+def decode(data, rec):
+    """Whole records in data -> (timestamps, temps_mC, flags, seqs or None)."""
+    n = len(data) // rec.size
+    if np is not None:
+        if rec is REC_V2:
+            dt = np.dtype([("ts", "=u8"), ("seq", "=u4"), ("temp", "=i4"), ("flags", "=u4"), ("_r", "=u4")])
+        else:
+            dt = np.dtype([("ts", "=u8"), ("temp", "=i4"), ("flags", "=u4")])
+        a = np.frombuffer(data, dtype=dt, count=n)
+        return a["ts"], a["temp"], a["flags"], a["seq"] if rec is REC_V2 else None
+    rows = list(rec.iter_unpack(data[:n * rec.size]))
+    if rec is REC_V2:
+        ts, seq, temp, flags, _ = zip(*rows) if rows else ((),) * 5
+        return ts, temp, flags, seq
+    ts, temp, flags = zip(*rows) if rows else ((),) * 3
+    return ts, temp, flags, None
+
+class Stats:
+    """Aggregates for --stats: one line per interval instead of one per sample."""
+    def __init__(self, exact):
+        self.exact = exact  # v2 sequence numbers: gaps are counted exactly
+        self.last_seq = None
+        self.reset(time.monotonic())
+
+    def reset(self, now):
+        self.t0, self.n, self.lo, self.hi, self.total = now, 0, None, None, 0
+        self.crossings = self.gaps = self.lost = 0
+
+    def add(self, ts, temp, flags, seq):
+        n = len(ts)
+        if not n:
+            return
+        if np is not None:
+            lo, hi, total = int(temp.min()), int(temp.max()), int(temp.sum(dtype=np.int64))
+            self.crossings += int(np.count_nonzero(flags & FLAG_THRESH))
+            overruns = int(np.count_nonzero(flags & FLAG_OVERRUN))
+        else:
+            lo, hi, total = min(temp), max(temp), sum(temp)
+            self.crossings += sum(1 for f in flags if f & FLAG_THRESH)
+            overruns = sum(1 for f in flags if f & FLAG_OVERRUN)
+        if seq is not None and np is not None:
+            if self.last_seq is not None:
+                seq = np.concatenate((np.array([self.last_seq], dtype=np.uint32), seq))
+            step = np.diff(seq).astype(np.int64)  # u32 arithmetic: wraps like the ring
+            jumps = step[step != 1]
+            self.gaps += len(jumps)
+            self.lost += int((jumps - 1).sum())
+            self.last_seq = int(seq[-1])
+        elif seq is not None:
+            prev = self.last_seq
+            for s in seq:
+                if prev is not None and (s - prev) & 0xffffffff != 1:
+                    self.gaps += 1
+                    self.lost += ((s - prev) & 0xffffffff) - 1
+                prev = s
+            self.last_seq = prev
+        else:
+            self.gaps += overruns
+        self.n += n
+        self.total += total
+        self.lo = lo if self.lo is None else min(self.lo, lo)
+        self.hi = hi if self.hi is None else max(self.hi, hi)
+
+    def report(self, now):
+        dt = now - self.t0
+        if self.n:
+            lost = f" lost={self.lost}" if self.exact else ""
+            print(f"rate={self.n / dt:.0f}/s n={self.n} min={self.lo / 1000.0:.3f}C "
+                  f"mean={self.total / self.n / 1000.0:.3f}C max={self.hi / 1000.0:.3f}C "
+                  f"crossings={self.crossings} gaps={self.gaps}{lost}", flush=True)
+        else:
+            print(f"rate=0/s n=0 ({dt:.1f}s without samples)", flush=True)
+        self.reset(now)
+
+def positive_seconds(text):
+    value = float(text)
+    if not value > 0:  # also rejects nan
+        raise argparse.ArgumentTypeError(f"{text!r} is not a positive number of seconds")
+    return value
+
 def main():
     ap = argparse.ArgumentParser(description="simtemp CLI (poll + read)")
     ap.add_argument("--sampling-ms", type=int)
     ap.add_argument("--threshold-mC", type=int)
-    ap.add_argument("--mode", choices=["normal","noisy","ramp"])
+    ap.add_argument("--mode", choices=["normal","noisy","ramp","sine","step","saw","replay"])
     ap.add_argument("--test", action="store_true", help="trigger threshold within ~2 periods")
+    ap.add_argument("--events", action="store_true",
+                    help="only wait for threshold crossing events (POLLPRI), skip the sample stream")
+    ap.add_argument("--summary", action="store_true",
+                    help="read one min/mean/max summary per window instead of every sample")
+    ap.add_argument("--window-us", type=int, help="aggregation window for --summary")
+    ap.add_argument("--batch", type=int, default=256,
+                    help="records per read() (default 256, 1 = one record per wakeup)")
+    ap.add_argument("--stats", type=positive_seconds, nargs="?", const=1.0, metavar="SECONDS",
+                    help="print only rate/min/mean/max/crossings/gaps every SECONDS (default 1)")
     args = ap.parse_args()
+    args.batch = max(1, args.batch)
 
     sysfs_base = "/sys/class/misc/simtemp"
     if args.sampling_ms:  write_attr(sysfs_base, "sampling_ms", args.sampling_ms)
     if args.threshold_mC: write_attr(sysfs_base, "threshold_mC", args.threshold_mC)
     if args.mode:         write_attr(sysfs_base, "mode", args.mode)
+    if args.window_us:    write_attr(sysfs_base, "window_us", args.window_us)
 
     fd = os.open(DEV, os.O_RDONLY)  # blocking
+    if args.summary:
+        fcntl.ioctl(fd, IOC_SET_STREAM, struct.pack("=I", STREAM_WINDOW))
+
+    # --stats prefers v2 records: their sequence numbers make every gap exact
+    rec = REC
+    if args.stats and not args.summary:
+        try:
+            fcntl.ioctl(fd, IOC_SET_FORMAT, struct.pack("=I", FORMAT_V2))
+            rec = REC_V2
+        except OSError:
+            pass  # older driver: count SIMTEMP_FLAG_OVERRUN instead
+    stats = Stats(rec is REC_V2) if args.stats else None
     poller = select.poll()
-    poller.register(fd, select.POLLIN | select.POLLPRI)
+    poller.register(fd, select.POLLPRI if args.events else select.POLLIN | select.POLLPRI)
 
     if args.test and sysfs_base:
         # Lower the threshold to get more crossing ev ents
         write_attr(sysfs_base, "threshold_mC", 26000)
 
+    timeout_ms = int(args.stats * 1000) if stats else 5000
     try:
         while True:
-            events = poller.poll(5000)  # ms timeout
+            events = poller.poll(timeout_ms)
+            if stats and time.monotonic() - stats.t0 >= args.stats:
+                stats.report(time.monotonic())
             if not events:
-                print("[timeout] no data"); continue
+                if not stats:
+                    print("[timeout] no data")
+                continue
 
             for (_fd, ev) in events:
                 if ev & (select.POLLERR | select.POLLHUP):
                     print("[error] device"); sys.exit(2)
 
-                if ev & (select.POLLIN | select.POLLPRI):
-                    data = os.read(fd, REC.size)
-                    if len(data) != REC.size:
+                if ev & select.POLLPRI:
+                    print_event(fd)
+                    if args.test:
+                        print("TEST: PASS (threshold event)"); sys.exit(0)
+
+                if ev & select.POLLIN and args.summary:
+                    print_window(os.read(fd, WIN.size))
+                elif ev & select.POLLIN:
+                    # one syscall for up to --batch records, decoded in bulk
+                    data = os.read(fd, rec.size * args.batch)
+                    if not data or len(data) % rec.size:
                         print("[short read]"); continue
-                    ts_ns, temp_mC, flags = REC.unpack(data)
-                    alert = 1 if (flags & FLAG_THRESH) else 0
-                    temp_C = temp_mC / 1000.0
-                    print(f"{ts_ns} temp={temp_C:.3f}C alert={alert}")
+                    ts, temp, flags, seq = decode(data, rec)
+                    if stats:
+                        stats.add(ts, temp, flags, seq)
+                        continue
+                    if np is not None:
+                        ts, temp, flags = ts.tolist(), temp.tolist(), flags.tolist()
+                    lines = []
+                    alert_seen = False
+                    for ts_ns, temp_mC, fl in zip(ts, temp, flags):
+                        alert = 1 if (fl & FLAG_THRESH) else 0
+                        alert_seen |= bool(alert)
+                        lines.append(f"{ts_ns} temp={temp_mC / 1000.0:.3f}C alert={alert}")
+                    print("\n".join(lines))
 
-                    if args.test and alert:
+                    if args.test and alert_seen:
                         print("TEST: PASS (threshold event)"); sys.exit(0)
 
             if args.test:
@@ -0,0 +1,157 @@
+// history.h - long sample history with min/max-per-column decimation
+//
+// Samples are kept in fixed blocks of BLOCK values, each with its own
+// min/max, and every SPAN consecutive blocks share a coarser min/max on
+// top. Rendering a time range into N pixel columns walks the coarse
+// level and only descends where a column edge cuts through: a span or
+// block that falls inside one column is merged through its summary, so
+// zoomed-out views cost O(N + spans in range) and zoomed-in ones
+// O(N + blocks in range).
+// Plain C++ (no Qt) so the tests can exercise it directly.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class HistoryStore {
+public:
+    static constexpr int BLOCK = 64;
+    static constexpr int SPAN = 64;  // blocks per coarse summary: 4096 samples
+
+    // One pixel column of a decimated view: every sample in it lies in [mn, mx].
+    struct Column {
+        int64_t t_ns;   // centre of the column
+        float mn;
+        float mx;
+    };
+
+    explicit HistoryStore(size_t max_samples = 8u << 20)
+        : max_blocks_(std::max<size_t>(1, max_samples / BLOCK)) {}
+
+    // Timestamps must not decrease; the oldest block goes once the store is full.
+    void append(int64_t t_ns, float v) {
+        if (blocks_.empty() || blocks_.back().n == BLOCK) {
+            if (blocks_.size() == max_blocks_) {
+                size_ -= blocks_.front().n;
+                blocks_.pop_front();
+                // the front span's summary still covers what was evicted
+                if (++evicted_ == spans_.front().blocks) {
+                    spans_.pop_front();
+                    evicted_ = 0;
+                }
+            }
+            blocks_.emplace_back();
+            if (spans_.empty() || spans_.back().blocks == SPAN)
+                spans_.emplace_back();
+            ++spans_.back().blocks;
+        }
+        Block& b = blocks_.back();
+        b.t[b.n] = t_ns;
+        b.v[b.n] = v;
+        b.mn = b.n ? std::min(b.mn, v) : v;
+        b.mx = b.n ? std::max(b.mx, v) : v;
+        ++b.n;
+        ++size_;
+
+        Span& s = spans_.back();
+        if (s.blocks == 1 && b.n == 1) {
+            s.t0 = t_ns;
+            s.mn = s.mx = v;
+        }
+        s.t1 = t_ns;
+        s.mn = std::min(s.mn, v);
+        s.mx = std::max(s.mx, v);
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    int64_t firstTime() const { return empty() ? 0 : blocks_.front().t[0]; }
+    int64_t lastTime() const { return empty() ? 0 : blocks_.back().t[blocks_.back().n - 1]; }
+
+    // Min/max of [t0, t1) split into @columns equal columns; empty columns are skipped.
+    void decimate(int64_t t0, int64_t t1, int columns, std::vector<Column>& out) const {
+        out.clear();
+        if (empty() || t1 <= t0 || columns <= 0)
+            return;
+
+        const double width = double(t1 - t0) / columns;
+        cols_.assign(columns, Acc{});
+        auto colOf = [&](int64_t t) {
+            return std::min(columns - 1, int((t - t0) / width));
+        };
+
+        // the range/width ratio picks the level: a span inside one column
+        // is merged whole, otherwise its blocks are, failing that their samples
+        auto inOneColumn = [&](int64_t first, int64_t last) {
+            return first >= t0 && last < t1 && colOf(first) == colOf(last);
+        };
+        auto sp = std::partition_point(spans_.begin(), spans_.end(),
+                                       [&](const Span& s) { return s.t1 < t0; });
+        for (; sp != spans_.end() && sp->t0 < t1; ++sp) {
+            const size_t k = size_t(sp - spans_.begin());
+            // a partly evicted front span's summary is stale: always descend
+            if ((k || !evicted_) && inOneColumn(sp->t0, sp->t1)) {
+                cols_[colOf(sp->t1)].merge(sp->mn, sp->mx);
+                continue;
+            }
+            const size_t first = k ? k * SPAN - evicted_ : 0;
+            const size_t end = std::min(blocks_.size(), (k + 1) * SPAN - evicted_);
+            for (size_t j = first; j < end; ++j) {
+                const Block& b = blocks_[j];
+                const int64_t last = b.t[b.n - 1];
+                if (last < t0)
+                    continue;
+                if (b.t[0] >= t1)
+                    break;
+                if (inOneColumn(b.t[0], last)) {
+                    cols_[colOf(last)].merge(b.mn, b.mx);
+                    continue;
+                }
+                for (int i = 0; i < b.n; ++i) {
+                    if (b.t[i] >= t0 && b.t[i] < t1)
+                        cols_[colOf(b.t[i])].merge(b.v[i], b.v[i]);
+                }
+            }
+        }
+
+        for (int c = 0; c < columns; ++c) {
+            if (cols_[c].any)
+                out.push_back({t0 + int64_t((c + 0.5) * width), cols_[c].mn, cols_[c].mx});
+        }
+    }
+
+private:
+    struct Block {
+        int64_t t[BLOCK];
+        float v[BLOCK];
+        float mn = 0, mx = 0;
+        int n = 0;
+    };
+
+    // SPAN consecutive blocks; only the newest span is ever short
+    struct Span {
+        int64_t t0 = 0, t1 = 0;  // first and last sample
+        float mn = 0, mx = 0;
+        int blocks = 0;
+    };
+
+    struct Acc {
+        float mn = 0, mx = 0;
+        bool any = false;
+        void merge(float lo, float hi) {
+            mn = any ? std::min(mn, lo) : lo;
+            mx = any ? std::max(mx, hi) : hi;
+            any = true;
+        }
+    };
+
+    std::deque<Block> blocks_;
+    std::deque<Span> spans_;      // spans_[k] holds blocks_[k * SPAN - evicted_ ...]
+    int evicted_ = 0;             // blocks already gone from spans_.front()
+    size_t max_blocks_;
+    size_t size_ = 0;
+    mutable std::vector<Acc> cols_;  // scratch, reused across calls
+};
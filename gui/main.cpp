@@ -1,33 +1,244 @@
 #include <QtWidgets>
 #include <QtCharts>
-#include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
-#include <sys/types.h>
-#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <errno.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <system_error>
+#include <thread>
 #include <utility>
+#include <vector>
 
-using namespace QtCharts;
+#include "simtemp_client.h"
+#include "history.h"
+#include "spsc_queue.h"
 
-#pragma pack(push,1)
-struct simtemp_sample {
-    uint64_t timestamp_ns;
-    int32_t  temp_mC;
-    uint32_t flags; // bit0=NEW_SAMPLE, bit1=THRESHOLD_CROSSED
-};
-#pragma pack(pop)
+using namespace QtCharts;
 
-static const char* DEV_PATH = "/dev/simtemp";
-static const char* SYSFS_BASE = "/sys/class/misc/simtemp";
+static const char* DEV_NAME = "simtemp";  // /dev/simtemp, /sys/class/misc/simtemp
 static const char* ALERT_GREEN = "#2e7d32";
 static const char* ALERT_RED   = "#c62828";
 
+/*
+ * Fixed-capacity circular buffer of plot values: push never allocates or
+ * shifts, the oldest value is overwritten once full. at(0) is the oldest.
+ */
+class PlotRing {
+public:
+    explicit PlotRing(int capacity) : buf_(capacity), head_(0), count_(0) {}
+
+    void push(double v) {
+        buf_[head_] = v;
+        head_ = (head_ + 1) % capacity();
+        if (count_ < capacity())
+            ++count_;
+    }
+
+    double at(int i) const {
+        return buf_[(head_ - count_ + i + capacity()) % capacity()];
+    }
+
+    int size() const { return count_; }
+    int capacity() const { return (int)buf_.size(); }
+    bool isEmpty() const { return count_ == 0; }
+
+private:
+    std::vector<double> buf_;
+    int head_;
+    int count_;
+};
+
+static constexpr int READ_BATCH = 256;  // records per read()
+
+// One read() worth of samples, already converted for plotting.
+struct SampleBatch {
+    int count;
+    bool alert;             // some record carried SIMTEMP_FLAG_THRESHOLD
+    uint32_t lastFlags;
+    int64_t timestamp_ns[READ_BATCH];
+    float tempC[READ_BATCH];
+};
+
+/*
+ * Acquisition thread: blocks in poll() on the device, drains it
+ * READ_BATCH records at a time (from the mmap ring when libsimtemp could
+ * map it) and hands decoded batches to the UI through a lock-free SPSC
+ * queue, so UI stalls no longer stop the device being read. An eventfd
+ * wakes it for pause/resume and shutdown. Every PERF_MS it also takes a
+ * SIMTEMP_IOC_GET_PERF snapshot for the stats panel, through a second
+ * queue: the Device is only ever touched from this thread.
+ */
+class DeviceReader {
+public:
+    static constexpr size_t QUEUE_BATCHES = 64;  // 16k samples of UI slack
+    static constexpr int PERF_MS = 500;
+    using Queue = SpscQueue<SampleBatch, QUEUE_BATCHES>;
+    using PerfQueue = SpscQueue<simtemp::Perf, 4>;
+
+    explicit DeviceReader(simtemp::Device& dev)
+        : dev_(dev), wakeFd_(::eventfd(0, EFD_CLOEXEC)), queue_(new Queue),
+          thread_([this] { run(); }) {}
+
+    ~DeviceReader() {
+        stop_.store(true);
+        wake();
+        thread_.join();
+        if (wakeFd_ >= 0) ::close(wakeFd_);
+    }
+
+    Queue& queue() { return *queue_; }
+    PerfQueue& perfQueue() { return perfQueue_; }
+
+    void setPaused(bool paused) {
+        paused_.store(paused);
+        wake();
+    }
+
+    // errno of the last failed read (0 if none); cleared by the call
+    int takeError() { return error_.exchange(0); }
+    // samples thrown away because the UI let the queue fill up
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    void wake() {
+        const uint64_t one = 1;
+        if (wakeFd_ >= 0)
+            (void)!::write(wakeFd_, &one, sizeof(one));
+    }
+
+    void run() {
+        simtemp_sample raw[READ_BATCH];
+        while (!stop_.load()) {
+            const bool paused = paused_.load();
+            struct pollfd pfd[2] = {
+                { wakeFd_, POLLIN, 0 },
+                { paused ? -1 : dev_.fd(), POLLIN, 0 },  // negative fd: ignored by poll
+            };
+            if (::poll(pfd, 2, PERF_MS) < 0) {
+                if (errno == EINTR)
+                    continue;
+                error_.store(errno);
+                return;
+            }
+            if (pfd[0].revents & POLLIN) {
+                uint64_t v;
+                (void)!::read(wakeFd_, &v, sizeof(v));
+            }
+            if (!paused && (pfd[1].revents & (POLLIN | POLLERR)))
+                drain(raw);
+            samplePerf();
+        }
+    }
+
+    // paused or not; a driver without the ioctl just never fills the panel
+    void samplePerf() {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - lastPerf_ < std::chrono::milliseconds(PERF_MS))
+            return;
+        lastPerf_ = now;
+        simtemp::Perf* p = perfQueue_.writeSlot();
+        if (p && dev_.getPerf(p) == 0)
+            perfQueue_.push();
+    }
+
+    void drain(simtemp_sample* raw) {
+        for (;;) {
+            const ssize_t n = dev_.read(raw, READ_BATCH, 0);
+            if (n < 0)
+                error_.store(int(-n));
+            if (n <= 0)
+                return;
+            const int count = int(n);
+            SampleBatch* b = queue_->writeSlot();
+            if (!b) {
+                dropped_.fetch_add(count, std::memory_order_relaxed);
+            } else {
+                b->count = count;
+                b->alert = false;
+                for (int i = 0; i < count; ++i) {
+                    b->timestamp_ns[i] = raw[i].timestamp_ns;
+                    b->tempC[i] = raw[i].temp_mC / 1000.0f;
+                    b->alert |= (raw[i].flags & SIMTEMP_FLAG_THRESHOLD) != 0;
+                }
+                b->lastFlags = raw[count - 1].flags;
+                queue_->push();
+            }
+            if (count < READ_BATCH)
+                return;
+        }
+    }
+
+    simtemp::Device& dev_;
+    int wakeFd_;
+    std::unique_ptr<Queue> queue_;
+    PerfQueue perfQueue_;
+    std::chrono::steady_clock::time_point lastPerf_;
+    std::atomic<bool> stop_{false};
+    std::atomic<bool> paused_{false};
+    std::atomic<int> error_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::thread thread_;  // last: starts once everything above is set up
+};
+
+/*
+ * Runs the sysfs reads and writes on its own thread (a sysfs store can block
+ * on the driver's config lock); results come back to the UI as queued signals.
+ * libsimtemp keeps each attribute open, so a refresh costs one pread() apiece.
+ */
+class SysfsWorker : public QObject {
+    Q_OBJECT
+public slots:
+    void read() {
+        long long sampling = -1, thr = 0;
+        std::string mode;
+        const bool okThr = sysfs_.readInt("threshold_mC", &thr) == 0;
+        if (sysfs_.readInt("sampling_ms", &sampling))
+            sampling = -1;
+        if (sysfs_.read("mode", &mode))
+            mode.clear();
+        emit configRead(int(sampling), okThr, int(thr), QString::fromStdString(mode));
+    }
+
+    void apply(int sampling, int thr, const QString& mode) {
+        QStringList errors;
+        auto put = [&](const char* attr, const std::string& value) {
+            if (const int ret = sysfs_.write(attr, value))
+                errors << QString("%1 (%2)").arg(attr).arg(strerror(-ret));
+        };
+        put("sampling_ms", std::to_string(sampling));
+        put("threshold_mC", std::to_string(thr));
+        put("mode", mode.toStdString());
+        if (errors.isEmpty())
+            read();
+        emit applied(errors.join(", "));
+    }
+
+    void stats() {
+        std::string text;
+        const bool ok = sysfs_.read("stats", &text) == 0;
+        emit statsRead(ok, QString::fromStdString(text));
+    }
+
+signals:
+    // sampling < 0 / empty mode: that attribute could not be read
+    void configRead(int sampling, bool okThr, int thr, const QString& mode);
+    void applied(const QString& errors);
+    void statsRead(bool ok, const QString& stats);
+
+private:
+    simtemp::Sysfs sysfs_{DEV_NAME};
+};
+
 class SimtempGui : public QWidget {
     Q_OBJECT
 public:
     SimtempGui(QWidget* parent=nullptr)
         : QWidget(parent),
-          fd_(-1),
-          notifier_(nullptr),
+          sysfs_(new SysfsWorker),
           series_(new QLineSeries(this)),
           chart_(new QChart()),
           view_(new QChartView(chart_)),
@@ -39,18 +250,44 @@ public:
           resetAlertBtn_(new QPushButton("Reset Alert")),
           statsBtn_(new QPushButton("Print Stats")),
           simToggleBtn_(new QPushButton("Stop Simulation")),
+          historyBox_(new QCheckBox("History (wheel: zoom, drag: pan)")),
+          perfLabel_(new QLabel("waiting for counters...")),
+          redrawTimer_(new QTimer(this)),
           alertLatched_(false),
-          running_(true)
+          running_(true),
+          points_(MAX_POINTS),
+          lastFlags_(0),
+          lastTempC_(0.0),
+          viewT0_(0),
+          viewT1_(0),
+          follow_(true),
+          dragging_(false),
+          dragX_(0),
+          lastPerf_{},
+          havePerf_(false)
     {
-        fd_ = ::open(DEV_PATH, O_RDONLY);
-        if (fd_ < 0) {
-            QMessageBox::critical(this, "Error", QString("Cannot open %1").arg(DEV_PATH));
+        sysfs_->moveToThread(&sysfsThread_);
+        connect(&sysfsThread_, &QThread::finished, sysfs_, &QObject::deleteLater);
+        connect(sysfs_, &SysfsWorker::configRead, this, &SimtempGui::onConfigRead);
+        connect(sysfs_, &SysfsWorker::applied, this, &SimtempGui::onApplied);
+        connect(sysfs_, &SysfsWorker::statsRead, this, &SimtempGui::onStatsRead);
+        sysfsThread_.start();
+
+        try {
+            dev_.reset(new simtemp::Device(DEV_NAME));
+        } catch (const std::system_error& e) {
+            QMessageBox::critical(this, "Error", QString("Cannot open device: %1").arg(e.what()));
             qApp->exit(1);
             return;
         }
 
-        notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Read, this);
-        connect(notifier_, &QSocketNotifier::activated, this, &SimtempGui::onDeviceReadable);
+        reader_.reset(new DeviceReader(*dev_));
+
+        // consume queued batches and repaint once per display frame
+        redrawTimer_->setInterval(FRAME_MS);
+        connect(redrawTimer_, &QTimer::timeout, this, &SimtempGui::onFrame);
+        plotPts_.reserve(MAX_POINTS);
+        view_->viewport()->installEventFilter(this);
 
         series_->setUseOpenGL(true);
         chart_->legend()->hide();
@@ -71,7 +308,8 @@ public:
         samplingSpin_->setSuffix(" ms");
         thresholdSpin_->setRange(-50000, 200000);
         thresholdSpin_->setSuffix(" m°C");
-        modeCombo_->addItems(QStringList() << "normal" << "noisy" << "ramp");
+        modeCombo_->addItems(QStringList() << "normal" << "noisy" << "ramp"
+                                             << "sine" << "step" << "saw" << "replay");
 
         alertLamp_->setAlignment(Qt::AlignCenter);
         auto alertText = new QLabel("Alert");
@@ -95,6 +333,18 @@ public:
         utilityButtons->addWidget(simToggleBtn_);
         utilityButtons->addStretch();
 
+        connect(historyBox_, &QCheckBox::toggled, this, [this](bool on) {
+            follow_ = true;
+            chart_->axisX()->setTitleText(on ? "seconds" : "samples");
+            redraw();
+        });
+
+        perfLabel_->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+        perfLabel_->setTextInteractionFlags(Qt::TextSelectableByMouse);
+        auto perfBox = new QGroupBox("Live stats");
+        auto perfLayout = new QVBoxLayout(perfBox);
+        perfLayout->addWidget(perfLabel_);
+
         auto lampBox = new QHBoxLayout;
         lampBox->addWidget(alertText);
         lampBox->addWidget(alertLamp_);
@@ -106,6 +356,8 @@ public:
         side->addSpacing(12);
         side->addLayout(lampBox);
         side->addLayout(utilityButtons);
+        side->addWidget(historyBox_);
+        side->addWidget(perfBox);
         side->addStretch();
         side->addWidget(status_);
 
@@ -122,81 +374,90 @@ public:
         connect(statsBtn_, &QPushButton::clicked, this, &SimtempGui::showStats);
         connect(simToggleBtn_, &QPushButton::clicked, this, &SimtempGui::toggleSimulation);
 
-        notifier_->setEnabled(running_);
+        redrawTimer_->start();
         resetAlertLamp();
         readSysfs();
         updateSimulationButton();
     }
 
     ~SimtempGui() override {
-        if (fd_ >= 0) ::close(fd_);
+        reader_.reset();  // joins the reader before the device goes away
+        dev_.reset();
+        sysfsThread_.quit();
+        sysfsThread_.wait();
     }
 
 private slots:
-    void onDeviceReadable() {
-        if (!running_)
-            return;
-
-        simtemp_sample s{};
-        ssize_t n = ::read(fd_, &s, sizeof(s));
-        if (n != (ssize_t)sizeof(s)) {
-            status_->setText("short read / device error");
+    // frame timer: take every batch the reader queued, then repaint once
+    void onFrame() {
+        if (!reader_)
             return;
+        DeviceReader::Queue& q = reader_->queue();
+        bool got = false;
+        while (const SampleBatch* b = q.front()) {
+            for (int i = 0; i < b->count; ++i) {
+                points_.push(b->tempC[i]);
+                history_.append(b->timestamp_ns[i], b->tempC[i]);
+            }
+            alertLatched_ |= b->alert;
+            lastTempC_ = b->tempC[b->count - 1];
+            lastFlags_ = b->lastFlags;
+            q.pop();
+            got = true;
         }
 
-        const double tempC = s.temp_mC / 1000.0;
-        const bool alert = (s.flags & (1u << 1)) != 0;
-
-        if (points_.size() >= MAX_POINTS)
-            points_.remove(0, 1);
-        points_.append(tempC);
-        updateSeriesAxis();
+        if (got)
+            redraw();
 
-        if (alert) {
-            alertLatched_ = true;
-            setAlertLampColor(ALERT_RED);
-        } else if (!alertLatched_) {
-            setAlertLampColor(ALERT_GREEN);
+        DeviceReader::PerfQueue& pq = reader_->perfQueue();
+        while (const simtemp::Perf* p = pq.front()) {
+            updatePerf(*p);
+            pq.pop();
         }
+        if (const int err = reader_->takeError())
+            status_->setText(QString("device read error: %1").arg(strerror(err)));
+    }
 
-        status_->setText(QString("temp=%1°C flags=0x%2")
-                         .arg(tempC, 0, 'f', 3)
-                         .arg(QString::number(s.flags, 16)));
+    // frame timer: one series update, axis rescale and status per frame
+    void redraw() {
+        if (historyBox_->isChecked())
+            updateHistoryView();
+        else
+            updateSeriesAxis();
+        setAlertLampColor(alertLatched_ ? ALERT_RED : ALERT_GREEN);
+        QString text = QString("temp=%1°C flags=0x%2")
+                           .arg(lastTempC_, 0, 'f', 3)
+                           .arg(QString::number(lastFlags_, 16));
+        if (const uint64_t lost = reader_ ? reader_->dropped() : 0)
+            text += QString(" ui_dropped=%1").arg(lost);
+        status_->setText(text);
     }
 
+    // sysfs requests run on sysfsThread_; answers arrive in the on*() slots
     void applySysfs() {
         const int sampling = samplingSpin_->value();
         const int thr = thresholdSpin_->value();
         const QString mode = modeCombo_->currentText();
-
-        QStringList errors;
-        QString errMsg;
-        if (!writeAttr("sampling_ms", QString::number(sampling), &errMsg))
-            errors << QString("sampling_ms (%1)").arg(errMsg);
-        if (!writeAttr("threshold_mC", QString::number(thr), &errMsg))
-            errors << QString("threshold_mC (%1)").arg(errMsg);
-        if (!writeAttr("mode", mode, &errMsg))
-            errors << QString("mode (%1)").arg(errMsg);
-
-        if (errors.isEmpty()) {
-            readSysfs();
-            status_->setText("sysfs applied");
-        } else {
-            status_->setText(QString("sysfs write failed: %1").arg(errors.join(", ")));
-        }
+        QMetaObject::invokeMethod(sysfs_, [=] { sysfs_->apply(sampling, thr, mode); });
     }
 
     void readSysfs() {
-        bool okSampling = false, okThr = false, okMode = false;
-        const QString sampling = readAttr("sampling_ms", &okSampling);
-        const QString thr = readAttr("threshold_mC", &okThr);
-        const QString mode = readAttr("mode", &okMode);
+        QMetaObject::invokeMethod(sysfs_, [this] { sysfs_->read(); });
+    }
+
+    void onApplied(const QString& errors) {
+        if (errors.isEmpty())
+            status_->setText("sysfs applied");
+        else
+            status_->setText(QString("sysfs write failed: %1").arg(errors));
+    }
 
-        if (okSampling)
-            samplingSpin_->setValue(sampling.toInt());
+    void onConfigRead(int sampling, bool okThr, int thr, const QString& mode) {
+        if (sampling >= 0)
+            samplingSpin_->setValue(sampling);
         if (okThr)
-            thresholdSpin_->setValue(thr.toInt());
-        if (okMode) {
+            thresholdSpin_->setValue(thr);
+        if (!mode.isEmpty()) {
             int idx = modeCombo_->findText(mode);
             if (idx >= 0)
                 modeCombo_->setCurrentIndex(idx);
@@ -212,34 +473,130 @@ private slots:
     }
 
     void toggleSimulation() {
-        if (!notifier_)
+        if (!reader_)
             return;
         running_ = !running_;
-        notifier_->setEnabled(running_);
+        reader_->setPaused(!running_);
         updateSimulationButton();
         status_->setText(running_ ? "simulation running" : "simulation paused");
     }
 
     void showStats() {
-        bool ok = false;
-        const QString stats = readAttr("stats", &ok);
-        if (!ok) {
-            QMessageBox::warning(this, "Stats", "stats read failed (need sudo?)");
-            status_->setText("stats read failed");
+        QMetaObject::invokeMethod(sysfs_, [this] { sysfs_->stats(); });
+    }
+
+    // non-modal, so the frame timer keeps running while the box is open
+    void onStatsRead(bool ok, const QString& stats) {
+        auto box = new QMessageBox(ok ? QMessageBox::Information : QMessageBox::Warning, "Stats",
+                                   ok ? stats : QString("stats read failed (need sudo?)"),
+                                   QMessageBox::Ok, this);
+        box->setAttribute(Qt::WA_DeleteOnClose);
+        box->open();
+        status_->setText(ok ? "stats displayed" : "stats read failed");
+    }
+
+protected:
+    // history mode: wheel zooms around the cursor, left drag pans
+    bool eventFilter(QObject* obj, QEvent* ev) override {
+        if (obj != view_->viewport() || !historyBox_->isChecked() || history_.empty())
+            return QWidget::eventFilter(obj, ev);
+
+        const QRectF area = chart_->plotArea();
+        auto timeAt = [&](qreal x) {
+            const double f = qBound(0.0, (x - area.left()) / area.width(), 1.0);
+            return viewT0_ + int64_t(f * (viewT1_ - viewT0_));
+        };
+
+        switch (ev->type()) {
+        case QEvent::Wheel: {
+            auto* we = static_cast<QWheelEvent*>(ev);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+            const qreal x = we->position().x();
+#else
+            const qreal x = we->pos().x();
+#endif
+            const int64_t pivot = timeAt(x);
+            const double k = we->angleDelta().y() > 0 ? 0.8 : 1.25;
+            setView(pivot - int64_t((pivot - viewT0_) * k),
+                    pivot + int64_t((viewT1_ - pivot) * k));
+            return true;
+        }
+        case QEvent::MouseButtonPress:
+            if (static_cast<QMouseEvent*>(ev)->button() == Qt::LeftButton) {
+                dragging_ = true;
+                dragX_ = static_cast<QMouseEvent*>(ev)->pos().x();
+                return true;
+            }
+            break;
+        case QEvent::MouseMove:
+            if (dragging_) {
+                const qreal x = static_cast<QMouseEvent*>(ev)->pos().x();
+                const int64_t dt = int64_t((dragX_ - x) / area.width() * (viewT1_ - viewT0_));
+                dragX_ = x;
+                setView(viewT0_ + dt, viewT1_ + dt);
+                return true;
+            }
+            break;
+        case QEvent::MouseButtonRelease:
+            dragging_ = false;
+            break;
+        default:
+            break;
+        }
+        return QWidget::eventFilter(obj, ev);
+    }
+
+private:
+    // clamp [t0, t1] to the recorded span; following resumes at the right edge
+    void setView(int64_t t0, int64_t t1) {
+        const int64_t first = history_.firstTime(), last = history_.lastTime();
+        const int64_t span = qBound<int64_t>(MIN_VIEW_NS, t1 - t0, qMax<int64_t>(MIN_VIEW_NS, last - first));
+        t0 = qBound(first, t0, qMax(first, last - span));
+        viewT0_ = t0;
+        viewT1_ = t0 + span;
+        follow_ = viewT1_ >= last;
+        updateHistoryView();
+    }
+
+    // cost depends on the plot width only: one min/max pair per pixel column
+    void updateHistoryView() {
+        if (history_.empty())
             return;
+        if (follow_) {
+            const int64_t span = viewT1_ > viewT0_ ? viewT1_ - viewT0_
+                                                   : history_.lastTime() - history_.firstTime();
+            viewT1_ = history_.lastTime() + 1;
+            viewT0_ = qMax(history_.firstTime(), viewT1_ - qMax<int64_t>(span, MIN_VIEW_NS));
+        }
+
+        const int columns = qMax(1, int(chart_->plotArea().width()));
+        history_.decimate(viewT0_, viewT1_, columns, columns_);
+
+        const int64_t origin = history_.firstTime();
+        double mn = 1e9, mx = -1e9;
+        plotPts_.resize(int(columns_.size()) * 2);
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            const double x = (columns_[i].t_ns - origin) / 1e9;
+            plotPts_[int(2 * i)] = QPointF(x, columns_[i].mn);
+            plotPts_[int(2 * i + 1)] = QPointF(x, columns_[i].mx);
+            mn = qMin(mn, double(columns_[i].mn));
+            mx = qMax(mx, double(columns_[i].mx));
         }
+        series_->replace(plotPts_);
 
-        QMessageBox::information(this, "Stats", stats);
-        status_->setText("stats displayed");
+        if (!columns_.empty()) {
+            const double pad = qMax(0.5, (mx - mn) * 0.1);
+            chart_->axisY()->setRange(mn - pad, mx + pad);
+        }
+        chart_->axisX()->setRange((viewT0_ - origin) / 1e9, (viewT1_ - origin) / 1e9);
     }
 
-private:
     void updateSeriesAxis() {
-        QVector<QPointF> pts;
-        pts.reserve(points_.size());
+        // plotPts_ keeps its capacity: no allocation per frame
+        plotPts_.resize(points_.size());
         for (int i = 0; i < points_.size(); ++i)
-            pts.append(QPointF(i, points_[i]));
-        series_->replace(pts);
+            plotPts_[i] = QPointF(i, points_.at(i));
+        series_->replace(plotPts_);
 
         if (!points_.isEmpty()) {
             auto [mn, mx] = minmax();
@@ -251,50 +608,48 @@ private:
 
     std::pair<double, double> minmax() const {
         double mn = 1e9, mx = -1e9;
-        for (double v : points_) {
-            mn = qMin(mn, v);
-            mx = qMax(mx, v);
+        for (int i = 0; i < points_.size(); ++i) {
+            mn = qMin(mn, points_.at(i));
+            mx = qMax(mx, points_.at(i));
         }
         return {mn, mx};
     }
 
-    QString sysPath(const char* name) const {
-        return QString("%1/%2").arg(SYSFS_BASE).arg(name);
-    }
-
-    QString readAttr(const char* name, bool* ok = nullptr) {
-        QFile f(sysPath(name));
-        if (!f.open(QIODevice::ReadOnly)) {
-            if (ok) *ok = false;
-            return {};
-        }
-        QByteArray data = f.readAll();
-        f.close();
-        if (ok) *ok = true;
-        return QString::fromUtf8(data).trimmed();
-    }
-
-    bool writeAttr(const char* name, const QString& val, QString* error = nullptr) {
-        QFile f(sysPath(name));
-        if (error) error->clear();
-        if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
-            if (error) *error = f.errorString();
-            return false;
-        }
-        QByteArray data = val.toUtf8();
-        data.append('\n');
-        auto n = f.write(data);
-        if (!f.flush()) {
-            if (error) *error = f.errorString();
-            f.close();
-            return false;
-        }
-        f.close();
-        if (n != data.size()) {
-            if (error) *error = f.errorString();
-            return false;
-        }
-        return true;
+    // rates come from the previous snapshot, PERF_MS earlier
+    void updatePerf(const simtemp::Perf& p) {
+        const simtemp::Perf& q = lastPerf_;
+        const double dt = havePerf_ && p.timestamp_ns > q.timestamp_ns
+                              ? (p.timestamp_ns - q.timestamp_ns) / 1e9 : 0.0;
+        auto rate = [dt](uint64_t now, uint64_t then) {
+            return dt > 0 ? QString::number((now - then) / dt, 'f', 0) + "/s" : QString("-");
+        };
+        const uint64_t reads = dt > 0 ? p.reads - q.reads : p.reads;
+        const uint64_t delivered = dt > 0 ? p.delivered - q.delivered : p.delivered;
+        const QString batch = reads ? QString::number(double(delivered) / reads, 'f', 1) : QString("-");
+
+        perfLabel_->setText(QString("produced    %1\n"
+                                    "wakeups     %2\n"
+                                    "overwrites  %3\n"
+                                    "timer miss  %4\n"
+                                    "high water  %5\n"
+                                    "readers     %6\n"
+                                    "-- this reader --\n"
+                                    "delivered   %7\n"
+                                    "bytes       %8\n"
+                                    "drops       %9\n"
+                                    "avg batch   %10")
+                                .arg(rate(p.total_samples, q.total_samples))
+                                .arg(rate(p.wakeups, q.wakeups))
+                                .arg(p.ring_overwrites)
+                                .arg(p.timer_overruns)
+                                .arg(p.ring_high_water)
+                                .arg(p.readers)
+                                .arg(rate(p.delivered, q.delivered))
+                                .arg(rate(p.bytes, q.bytes))
+                                .arg(p.drops)
+                                .arg(batch));
+        lastPerf_ = p;
+        havePerf_ = true;
     }
 
     void setAlertLampColor(const QString& color) {
@@ -310,9 +665,13 @@ private:
 
 private:
     static constexpr int MAX_POINTS = 512;
+    static constexpr int FRAME_MS = 16;     // ~60 Hz repaint
+    static constexpr int64_t MIN_VIEW_NS = 10000000;  // deepest zoom: 10 ms
 
-    int fd_;
-    QSocketNotifier* notifier_;
+    std::unique_ptr<simtemp::Device> dev_;
+    std::unique_ptr<DeviceReader> reader_;
+    SysfsWorker* sysfs_;        // lives on sysfsThread_
+    QThread sysfsThread_;
     QLineSeries* series_;
     QChart* chart_;
     QChartView* view_;
@@ -324,11 +683,30 @@ private:
     QPushButton* resetAlertBtn_;
     QPushButton* statsBtn_;
     QPushButton* simToggleBtn_;
+    QCheckBox* historyBox_;
+    QLabel* perfLabel_;
+    QTimer* redrawTimer_;
 
     bool alertLatched_;
     bool running_;
     QString alertLampColor_;
-    QVector<double> points_;
+    PlotRing points_;
+    QVector<QPointF> plotPts_;
+    uint32_t lastFlags_;
+    double lastTempC_;
+
+    // history mode: everything since start-up, viewed over [viewT0_, viewT1_)
+    HistoryStore history_;
+    std::vector<HistoryStore::Column> columns_;
+    int64_t viewT0_;
+    int64_t viewT1_;
+    bool follow_;      // keep the right edge on the newest sample
+    bool dragging_;
+    qreal dragX_;
+
+    // stats panel: the previous SIMTEMP_IOC_GET_PERF snapshot
+    simtemp::Perf lastPerf_;
+    bool havePerf_;
 };
 
 int main(int argc, char** argv) {
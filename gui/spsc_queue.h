@@ -0,0 +1,56 @@
+// spsc_queue.h - bounded lock-free single-producer/single-consumer queue
+//
+// Slots are filled and drained in place: the producer writes into
+// writeSlot() and publishes it with push(), the consumer reads front() and
+// hands it back with pop(). No allocation or copy after construction, and
+// each side only ever stores its own index (release) and loads the other's
+// (acquire). Plain C++ (no Qt) so the tests can exercise it directly.
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+    static constexpr size_t capacity() { return N; }
+
+    // producer: the next free slot, or nullptr when the consumer is N behind
+    T* writeSlot() {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tailCache_ == N) {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (head - tailCache_ == N)
+                return nullptr;
+        }
+        return &slots_[head & (N - 1)];
+    }
+
+    // producer: make the slot returned by writeSlot() visible
+    void push() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // consumer: the oldest published slot, or nullptr when empty
+    const T* front() {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == headCache_) {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail == headCache_)
+                return nullptr;
+        }
+        return &slots_[tail & (N - 1)];
+    }
+
+    // consumer: give the slot returned by front() back to the producer
+    void pop() { tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+private:
+    std::array<T, N> slots_{};
+    // each index on its own cache line, next to the copy of the other side's
+    alignas(64) std::atomic<size_t> head_{0};
+    size_t tailCache_ = 0;
+    alignas(64) std::atomic<size_t> tail_{0};
+    size_t headCache_ = 0;
+};
@@ -9,13 +9,32 @@
 #include <linux/hrtimer.h>
 #include <linux/workqueue.h>
 #include <linux/wait.h>
+#include <linux/sched/signal.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/seqlock.h>
+#include <linux/capability.h>
 #include <linux/atomic.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/uio.h>
 #include "nxp_simtemp.h"
 #include <linux/poll.h>
 #include <linux/device.h>   /* for sysfs device attributes */
 #include <linux/sysfs.h>    /* for DEVICE_ATTR macros */
+#include <linux/cpumask.h>
+#include <linux/smp.h>
+#include <linux/topology.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/firmware.h>
+#include <linux/rcupdate.h>
+#include <linux/fixp-arith.h>
 
+#define CREATE_TRACE_POINTS
+#include "simtemp_trace.h"
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Gius Pianfort");
@@ -24,66 +43,704 @@ MODULE_VERSION("1.0");
 
 /* ---- Config (temporal) ---- */
 #define SIMTEMP_PERIOD_MS   100       /* 10 Hz */
-#define RING_SIZE           128
-#define RB_MASK   (RING_SIZE - 1)     /* Power of 2 to use AND instead of % */
+#define SIMTEMP_PERIOD_US_MIN 20        /* 50 kHz */
+#define SIMTEMP_WINDOW_US_MIN  1000       /* aggregation window bounds */
+#define SIMTEMP_WINDOW_US_MAX  60000000
+#define SIMTEMP_DEADBAND_MC_MAX 100000     /* send-on-change filter bounds */
+#define SIMTEMP_HEARTBEAT_US_MAX 60000000
+#define SIMTEMP_PERIOD_US_MAX 10000000  /* 10 s */
+#define SIMTEMP_WAKE_LATENCY_US_MAX 10000000  /* 10 s */
+#define SIMTEMP_BURST_MAX   4096
+#define RING_SIZE_DEFAULT   128
+#define RING_SIZE_MIN       16
+#define RING_SIZE_MAX       (1u << 24)      /* 16M records = 256 MiB of samples */
+#define RB_DATA_OFFSET      PAGE_SIZE       /* samples start after the control page */
+#define RB_CHUNK            256             /* records copied between overwrite checks */
 
-/* ---- Device state ---- */
+static unsigned int ring_size = RING_SIZE_DEFAULT;
+module_param(ring_size, uint, 0444);
+MODULE_PARM_DESC(ring_size, "Initial ring capacity in records (power of two, 16..16M)");
+
+#define SIMTEMP_MAX_DEVICES 64
+
+/*
+ * ---- Waveform engine ----
+ * One cycle of each table waveform in Q15, filled once at init. Samples
+ * step a 32-bit phase accumulator; its top bits index the table.
+ */
+#define SIMTEMP_WAVE_SHIFT     10
+#define SIMTEMP_WAVE_LEN       (1 << SIMTEMP_WAVE_SHIFT)
+#define SIMTEMP_WAVE_AMP_MAX   50000
+#define SIMTEMP_WAVE_US_MIN    1000
+#define SIMTEMP_WAVE_US_MAX    60000000
+#define SIMTEMP_REPLAY_MAX     (4 << 20)    /* samples in a replay trace */
+#define SIMTEMP_BASE_MC        25000        /* centre of every waveform */
+
+static s16 simtemp_wave_tab[3][SIMTEMP_WAVE_LEN];  /* sine, step, saw */
+
+/* A loaded replay trace; replaced as a whole, freed after a grace period */
+struct simtemp_replay {
+    u32 count;
+    char name[64];
+    s32 mC[];
+};
+
+/* /sys/kernel/debug/simtemp/<name>/ for the latency histograms */
+static struct dentry *simtemp_debugfs_root;
+
+/* high-priority, per-CPU bound: placement of every producer work is explicit */
+static struct workqueue_struct *simtemp_wq;
+
+static unsigned int num_devices = 1;
+module_param(num_devices, uint, 0444);
+MODULE_PARM_DESC(num_devices, "Number of simulated sensors (1..64): /dev/simtemp, /dev/simtemp1, ...");
+
+/*
+ * ---- Latency instrumentation ----
+ * log2 histograms of nanoseconds: bucket b counts values in
+ * [2^(b-1), 2^b), bucket 0 counts zero, the last one everything above.
+ * Per-CPU, so recording is one this_cpu_inc() and never contends.
+ */
+#define SIMTEMP_HIST_BUCKETS 32         /* last bucket: >= ~1.07 s */
+
+enum {
+    SIMTEMP_LAT_EXPIRY_TO_GEN,       /* hrtimer expiry -> burst generation starts */
+    SIMTEMP_LAT_GEN_TO_PUBLISH,      /* generation starts -> head published */
+    SIMTEMP_LAT_SAMPLE_TO_READ,      /* sample timestamp -> copied to a reader */
+    SIMTEMP_LAT_PERIOD_ERROR,        /* |expiry interval - period| */
+    SIMTEMP_LAT_NR,
+};
+
+static const char * const simtemp_lat_names[SIMTEMP_LAT_NR] = {
+    "expiry_to_gen", "gen_to_publish", "sample_to_read", "period_error",
+};
+
+struct simtemp_hist {
+    u64 bucket[SIMTEMP_LAT_NR][SIMTEMP_HIST_BUCKETS];
+};
+
+/* ---- Device state: one per simulated sensor ---- */
 struct simtemp_dev {
-    /* ring buffer */
-    struct simtemp_sample buf[RING_SIZE];
-    u32 head;              /* next write index */
-    u32 tail;              /* next read index  */
-    spinlock_t lock;
+    struct miscdevice misc; /* /dev/<name> and /sys/class/misc/<name> */
+    char name[16];         /* "simtemp" for instance 0, "simtempN" after that */
+
+    /* ring buffer: control page + samples in one mmap()-able vmalloc area */
+    struct simtemp_ring_ctrl *ctrl;  /* head/tail live here, shared with user space */
+    struct simtemp_sample *buf;
+    u32 size;              /* slots, power of 2 to use AND instead of % */
+    u32 mask;              /* size - 1 */
+    size_t bytes;          /* control page + slots, page aligned */
+    int ring_node;         /* NUMA node the ring pages were allocated on */
+    struct mutex ring_lock; /* ring (re)allocation vs. open files */
+    int open_count;        /* files holding cursors into the ring */
+    int map_count;         /* live mappings of the ring pages, under ring_lock */
 
     /* sync & stats */
     wait_queue_head_t wq;  /* readers sleep here when empty */
     atomic64_t total_samples;
     atomic64_t threshold_crossings;
+    atomic64_t ring_overwrites;  /* oldest record dropped by the producer */
+    atomic64_t reader_overruns;  /* records some reader lagged past and lost */
+    atomic64_t wakeups;          /* wait queue wakeups issued by the producer */
+    atomic64_t suppressed;       /* samples dropped by the deadband filter */
+    atomic64_t timer_overruns;   /* periods skipped by the timer or left unrun by the work */
+    atomic_t high_water;         /* deepest read() backlog, see simtemp_note_backlog() */
+
+    /* threshold crossing events: tiny broadcast ring, see simtemp_push_event() */
+    spinlock_t ev_lock;    /* producer may run in hardirq (timer) context */
+    struct simtemp_event events[SIMTEMP_EVENT_QUEUE];
+    u32 ev_head;           /* sequence of the next event */
+    wait_queue_head_t ev_wq; /* SIMTEMP_IOC_GET_EVENT sleepers */
+
+    /* windowed aggregation: the open window is producer-only state */
+    u32 win_us;            /* window length the open one was started with */
+    u64 win_start_ns;      /* open window covers [win_start_ns, win_end_ns) */
+    u64 win_end_ns;
+    s64 win_sum;
+    s32 win_min, win_max;
+    u32 win_count, win_crossings;
+    /* closed windows: broadcast ring like events[], see simtemp_push_window() */
+    spinlock_t win_lock;
+    struct simtemp_window windows[SIMTEMP_WINDOW_QUEUE];
+    u32 win_head;          /* sequence of the next closed window */
     
-    /* configurable parameters */
-    int period_ms;         /* sampling period in milliseconds */
-    s32 threshold_mC;      /* alert threshold in milli-Celsius */
-    int mode;              /* 0=normal, 1=noisy, 2=ramp */
+    /*
+     * configurable parameters: cfg is only replaced as a whole, under
+     * cfg_seq, so the producer always works from a consistent snapshot
+     */
+    struct mutex cfg_lock; /* serializes config writers (sysfs, ioctl) */
+    seqlock_t cfg_seq;     /* producer may read cfg in hardirq context */
+    struct simtemp_config cfg;
+    int batch_min;         /* blocking read() waits for this many records */
+    int batch_timeout_ms;  /* ...but no longer than this (0 = no limit) */
     
     /* threshold crossing detection */
     bool above_threshold;  /* previous sample was above threshold */
 
+    /* generator state, producer-only */
+    s32 ramp_mC;           /* ramp mode */
+    u32 prng;              /* noisy mode: xorshift32, never 0 */
+    u32 wave_phase;        /* table modes: cycle position, 2^32 = one cycle */
+    u32 replay_pos;        /* replay mode: next trace index */
+    struct simtemp_replay __rcu *replay;  /* written under cfg_lock */
+
+    /* a burst is generated here and only its deadband survivors reach the ring */
+    struct simtemp_sample *stage;   /* SIMTEMP_BURST_MAX records, producer-only */
+
+    /* deadband filter, producer-only: the last sample actually published */
+    bool db_valid;
+    s32 db_last_mC;
+    u64 db_last_ns;
+
     /* producer */
     struct hrtimer timer;
-    ktime_t period;
+    ktime_t period;        /* cfg.period_us as ktime, for the timer */
+    int producer;          /* SIMTEMP_PRODUCER_WORK or _TIMER */
+    int cpu;               /* timer + work run here, ring on its node (-1 = any) */
+    u64 fired_ns;          /* last timer expiry, stamped on work-mode samples */
+    u64 expiry_ns;         /* ...and its programmed expiry time */
+    u64 last_fire_ns;      /* previous expiry, for the period error (0 = none) */
+    u64 last_stamp_ns;     /* newest timestamp handed to a sample, producer-only */
     struct work_struct work;
+
+    /* wakeup coalescing */
+    u32 wake_head;         /* head at the last wakeup */
+    struct hrtimer flush_timer; /* bounds the latency below wake_mark */
+
+    /* instrumentation */
+    struct simtemp_hist __percpu *hist;
+    struct dentry *debugfs;
+
+    /* slow path: threshold log lines, kept out of the sampling path */
+    struct work_struct log_work;
+    s32 log_temp_mC;
+    s32 log_threshold_mC;
+    bool log_up;
+};
+
+enum {
+    SIMTEMP_PRODUCER_WORK,   /* timer -> workqueue -> sample (process context) */
+    SIMTEMP_PRODUCER_TIMER,  /* sample generated in the hrtimer callback itself */
+};
+
+/* ---- Per-open-file state: every opener is an independent reader ---- */
+struct simtemp_file {
+    struct simtemp_dev *dev; /* instance this file was opened on */
+    struct mutex read_lock; /* serializes read() calls sharing this file */
+    u32 cursor;            /* sequence of the next record this reader gets */
+    u64 overruns;          /* records lost because this reader lagged */
+    u64 delivered;         /* SIMTEMP_IOC_GET_PERF: records, bytes and calls */
+    u64 bytes;             /* ...of read()s that returned data */
+    u64 reads;
+    bool mapped;           /* ring is mmap()ed: poll() follows head, not cursor */
+    u32 poll_head;         /* head last reported as POLLIN to a mapped poller */
+    u32 ev_cursor;         /* next threshold event this file gets */
+    u32 stream;            /* SIMTEMP_STREAM_*: what read() returns */
+    u32 format;            /* SIMTEMP_FORMAT_* of raw records */
+    void *enc;             /* encoding buffer of one chunk, for formats other than V1 */
+    u32 win_cursor;        /* next window summary this file gets */
 };
 
-static struct simtemp_dev *gdev;
+static struct simtemp_dev *simtemp_devs[SIMTEMP_MAX_DEVICES];
+
+static inline void simtemp_hist_add(struct simtemp_dev *d, int which, s64 ns)
+{
+    unsigned int b = ns > 0 ? min(fls64(ns), SIMTEMP_HIST_BUCKETS - 1) : 0;
+
+    this_cpu_inc(d->hist->bucket[which][b]);
+}
+
+/* sysfs callbacks get the misc device's struct device; its drvdata is &d->misc */
+static inline struct simtemp_dev *to_simtemp(struct device *dev)
+{
+    struct miscdevice *misc = dev_get_drvdata(dev);
+
+    return container_of(misc, struct simtemp_dev, misc);
+}
 
-/* ---- Ring buffer helpers (single-producer, multi-consumer safe with spinlock) ---- */
-static inline bool rb_is_empty(struct simtemp_dev *d)
+/*
+ * ---- Ring buffer helpers (lock-free: single writer, any number of readers) ----
+ * head/tail are free-running sequence numbers; slot = seq & d->mask.
+ * tail is the oldest record still held; rb_capacity() records are
+ * readable at any time. Readers never consume for each other: each one
+ * walks the ring with its own cursor and the writer just overwrites the
+ * oldest slots, so a slow reader can't stall the producer.
+ *
+ * Only the producer writes the ring. It announces the slots it is about
+ * to overwrite in reserve, fills them, and publishes head with release
+ * semantics. Readers load head with acquire, copy, and then check reserve
+ * to detect slots that were overwritten under them (see nxp_simtemp.h).
+ * No lock is taken and interrupts stay enabled on the whole data path.
+ */
+static inline u32 rb_capacity(struct simtemp_dev *d)
 {
-    return d->head == d->tail;
+    return d->size - 1;
 }
 
-static inline bool rb_is_full(struct simtemp_dev *d)
+static inline struct simtemp_sample *rb_slot(struct simtemp_dev *d, u32 seq)
 {
-    return ((d->head + 1) % RING_SIZE) == d->tail;
+    return &d->buf[seq & d->mask];
 }
 
-static inline void rb_push(struct simtemp_dev *d, const struct simtemp_sample *s)
+/* Claim @n slots after head for writing; returns the first sequence */
+static inline u32 rb_reserve(struct simtemp_dev *d, u32 n)
 {
-    if (rb_is_full(d)) {
-        d->tail = (d->tail + 1) % RING_SIZE;
+    u32 head = d->ctrl->head;
+    u32 held = head - d->ctrl->tail;
+
+    if (held + n > rb_capacity(d)) {
+        u32 drop = held + n - rb_capacity(d);
+
+        WRITE_ONCE(d->ctrl->tail, d->ctrl->tail + drop);
+        atomic64_add(drop, &d->ring_overwrites);
+        trace_simtemp_ring_overwrite(d->name, d->ctrl->tail, drop);
     }
 
-    d->buf[d->head] = *s;
-    d->head = (d->head + 1) & RB_MASK;
+    /* readers validate copies against reserve: announce before overwriting */
+    WRITE_ONCE(d->ctrl->reserve, head + n);
+    smp_wmb();
+    return head;
 }
 
-static inline bool rb_pop(struct simtemp_dev *d, struct simtemp_sample *out)
+/* Expose the @n records written after rb_reserve() with one head store */
+static inline void rb_commit(struct simtemp_dev *d, u32 head, u32 n)
 {
-    if (rb_is_empty(d))
-        return false;
-    *out = d->buf[d->tail];
-    d->tail = (d->tail + 1) % RING_SIZE;
-    return true;
+    smp_store_release(&d->ctrl->head, head + n);
+}
+
+/* Records queued for reader @f (may exceed rb_capacity() if it lagged) */
+static inline u32 rb_avail(struct simtemp_dev *d, struct simtemp_file *f)
+{
+    return smp_load_acquire(&d->ctrl->head) - READ_ONCE(f->cursor);
+}
+
+/* Raise ring_high_water to @backlog records, at most a full ring */
+static void simtemp_note_backlog(struct simtemp_dev *d, u32 backlog)
+{
+    int old = atomic_read(&d->high_water);
+    int seen;
+
+    backlog = min(backlog, rb_capacity(d));
+    while ((int)backlog > old) {
+        seen = atomic_cmpxchg(&d->high_water, old, backlog);
+        if (seen == old)
+            break;
+        old = seen;     /* another reader raised it meanwhile */
+    }
+}
+
+/* Copy @n records starting at sequence @seq into @to, minding the wrap */
+static size_t rb_copy_to_iter(struct simtemp_dev *d, u32 seq, u32 n,
+                              struct iov_iter *to)
+{
+    const size_t rec = sizeof(struct simtemp_sample);
+    u32 idx = seq & d->mask;
+    u32 first = min(n, d->size - idx);
+    size_t copied;
+
+    copied = copy_to_iter(&d->buf[idx], first * rec, to);
+    if (copied == first * rec && n > first)
+        copied += copy_to_iter(d->buf, (n - first) * rec, to);
+    return copied;
+}
+
+/*
+ * Copy up to @max records for reader @f straight from the ring into @to,
+ * RB_CHUNK records at a time. After each chunk, reserve is re-read: if the
+ * producer lapped the start of the chunk meanwhile, the iterator is
+ * reverted, the reader skips to the oldest intact record and copies the
+ * chunk again. The first record after every such hole gets
+ * SIMTEMP_FLAG_OVERRUN; *@lost counts the skipped records. Caller holds
+ * f->read_lock.
+ */
+static ssize_t rb_read_iter(struct simtemp_dev *d, struct simtemp_file *f,
+                            struct iov_iter *to, u32 max, u32 *lost, u64 *first_ts)
+{
+    const size_t rec = sizeof(struct simtemp_sample);
+    const u32 cap = rb_capacity(d);
+    u32 cursor = f->cursor;
+    u32 done = 0, gap = 0;
+
+    *lost = 0;
+    while (done < max) {
+        u32 head = smp_load_acquire(&d->ctrl->head);
+        size_t copied;
+        u32 n, reserve;
+        u64 ts;
+
+        if (head - cursor > cap) {
+            /* lapped: everything older than head - cap is gone */
+            gap += head - cursor - cap;
+            cursor = head - cap;
+        }
+
+        n = min3(head - cursor, max - done, (u32)RB_CHUNK);
+        if (!n)
+            break;
+
+        /* kept only if the chunk turns out intact */
+        ts = READ_ONCE(rb_slot(d, cursor)->timestamp_ns);
+        if (gap) {
+            /* flag the first record after the hole on its way out */
+            struct simtemp_sample first = *rb_slot(d, cursor);
+
+            first.flags |= SIMTEMP_FLAG_OVERRUN;
+            copied = copy_to_iter(&first, rec, to);
+            if (copied == rec)
+                copied += rb_copy_to_iter(d, cursor + 1, n - 1, to);
+        } else {
+            copied = rb_copy_to_iter(d, cursor, n, to);
+        }
+        if (copied != n * rec) {
+            iov_iter_revert(to, copied);
+            return done ? (ssize_t)done : -EFAULT;
+        }
+
+        /* pairs with the smp_wmb() in rb_reserve() */
+        smp_rmb();
+        reserve = READ_ONCE(d->ctrl->reserve);
+        if (reserve - cursor > cap) {
+            /*
+             * torn: skip to the oldest record the producer is not
+             * rewriting, or we would copy the same chunk until it commits
+             */
+            iov_iter_revert(to, copied);
+            gap += reserve - cap - cursor;
+            cursor = reserve - cap;
+            continue;
+        }
+
+        if (!done)
+            *first_ts = ts;
+        *lost += gap;
+        gap = 0;
+        cursor += n;
+        done += n;
+        WRITE_ONCE(f->cursor, cursor);
+    }
+
+    return done;
+}
+
+/* ---- Encoded read formats (SIMTEMP_FORMAT_V2 / _COMPACT) ---- */
+#define SIMTEMP_ENC_BYTES   (RB_CHUNK * sizeof(struct simtemp_sample_v2))
+
+/* Records of @fmt that fit in @bytes of user buffer (0: not even one) */
+static u32 simtemp_format_fit(u32 fmt, size_t bytes)
+{
+    size_t n;
+
+    switch (fmt) {
+    case SIMTEMP_FORMAT_V2:
+        n = bytes / sizeof(struct simtemp_sample_v2);
+        break;
+    case SIMTEMP_FORMAT_COMPACT:
+        if (bytes < sizeof(struct simtemp_compact_hdr))
+            return 0;
+        n = (bytes - sizeof(struct simtemp_compact_hdr)) / sizeof(struct simtemp_compact);
+        break;
+    default:
+        n = bytes / sizeof(struct simtemp_sample);
+        break;
+    }
+    return min_t(size_t, n, U32_MAX);
+}
+
+/*
+ * Encode up to @n ring records from @seq into @out; returns the bytes
+ * produced and sets *@used to the records consumed (a compact batch ends
+ * early when a delta would overflow). Slots are read without any care:
+ * the caller validates the chunk against reserve before using it.
+ */
+static size_t simtemp_encode(struct simtemp_dev *d, u32 fmt, u32 seq, u32 n,
+                             bool overrun, void *out, u32 *used)
+{
+    u32 i;
+
+    if (fmt == SIMTEMP_FORMAT_V2) {
+        struct simtemp_sample_v2 *r = out;
+
+        for (i = 0; i < n; i++) {
+            const struct simtemp_sample *s = rb_slot(d, seq + i);
+
+            r[i].timestamp_ns = s->timestamp_ns;
+            r[i].seq          = seq + i;
+            r[i].temp_mC      = s->temp_mC;
+            r[i].flags        = s->flags;
+            r[i].reserved     = 0;
+        }
+        if (overrun)
+            r[0].flags |= SIMTEMP_FLAG_OVERRUN;
+        *used = n;
+        return n * sizeof(*r);
+    } else {
+        struct simtemp_compact_hdr *h = out;
+        struct simtemp_compact *e = (struct simtemp_compact *)(h + 1);
+        u64 base = rb_slot(d, seq)->timestamp_ns;
+
+        for (i = 0; i < n; i++) {
+            const struct simtemp_sample *s = rb_slot(d, seq + i);
+            u64 delta = s->timestamp_ns - base;
+
+            if (delta > U32_MAX)
+                break;
+            e[i].delta_ns = delta;
+            e[i].value    = SIMTEMP_COMPACT_VALUE(s->temp_mC, s->flags);
+        }
+        h->base_ns = base;
+        h->seq     = seq;
+        h->count   = i;
+        h->flags   = overrun ? SIMTEMP_COMPACT_OVERRUN : 0;
+        *used = i;
+        return sizeof(*h) + i * sizeof(*e);
+    }
+}
+
+/*
+ * rb_read_iter() for the encoded formats: each chunk is encoded into
+ * f->enc, validated against reserve and only then copied out, so a torn
+ * chunk never reaches the iterator. Returns records; caller holds
+ * f->read_lock.
+ */
+static ssize_t rb_read_encoded(struct simtemp_dev *d, struct simtemp_file *f,
+                               struct iov_iter *to, u32 *lost, u64 *first_ts)
+{
+    const u32 cap = rb_capacity(d);
+    u32 cursor = f->cursor;
+    u32 done = 0, gap = 0;
+
+    *lost = 0;
+    for (;;) {
+        u32 head = smp_load_acquire(&d->ctrl->head);
+        size_t bytes, copied;
+        u32 n, reserve;
+        u64 ts;
+
+        if (head - cursor > cap) {
+            gap += head - cursor - cap;
+            cursor = head - cap;
+        }
+
+        n = min3(head - cursor, simtemp_format_fit(f->format, iov_iter_count(to)),
+                 (u32)RB_CHUNK);
+        if (!n)
+            break;
+
+        ts = READ_ONCE(rb_slot(d, cursor)->timestamp_ns);
+        bytes = simtemp_encode(d, f->format, cursor, n, gap, f->enc, &n);
+
+        /* pairs with the smp_wmb() in rb_reserve() */
+        smp_rmb();
+        reserve = READ_ONCE(d->ctrl->reserve);
+        if (reserve - cursor > cap) {
+            /* torn: encode again from the oldest record not being rewritten */
+            gap += reserve - cap - cursor;
+            cursor = reserve - cap;
+            continue;
+        }
+
+        copied = copy_to_iter(f->enc, bytes, to);
+        if (copied != bytes) {
+            iov_iter_revert(to, copied);
+            return done ? (ssize_t)done : -EFAULT;
+        }
+
+        if (!done)
+            *first_ts = ts;
+        *lost += gap;
+        gap = 0;
+        cursor += n;
+        done += n;
+        WRITE_ONCE(f->cursor, cursor);
+    }
+
+    return done;
+}
+
+/*
+ * Allocate an empty ring of @size slots on NUMA @node: one zeroed vmalloc
+ * area holding the control page followed by the samples, mapped to user
+ * space page by page in simtemp_mmap(). Large rings are fine here;
+ * nothing is embedded in struct simtemp_dev.
+ */
+static struct simtemp_ring_ctrl *rb_alloc(u32 size, int node, size_t *bytes)
+{
+    struct simtemp_ring_ctrl *ctrl;
+
+    *bytes = RB_DATA_OFFSET + PAGE_ALIGN((size_t)size * sizeof(struct simtemp_sample));
+    ctrl = vzalloc_node(*bytes, node);
+    if (!ctrl)
+        return NULL;
+
+    ctrl->magic = SIMTEMP_RING_MAGIC;
+    ctrl->version = SIMTEMP_RING_VERSION;
+    ctrl->capacity = size;
+    ctrl->record_size = sizeof(struct simtemp_sample);
+    ctrl->data_offset = RB_DATA_OFFSET;
+    return ctrl;
+}
+
+static void rb_install(struct simtemp_dev *d, struct simtemp_ring_ctrl *ctrl,
+                       u32 size, size_t bytes)
+{
+    d->ctrl = ctrl;
+    d->buf = (void *)ctrl + RB_DATA_OFFSET;
+    d->size = size;
+    d->mask = size - 1;
+    d->bytes = bytes;
+}
+
+static bool rb_size_valid(unsigned int size)
+{
+    return is_power_of_2(size) && size >= RING_SIZE_MIN && size <= RING_SIZE_MAX;
+}
+
+/* NUMA node the ring of @d belongs on: the one of its producer CPU */
+static int simtemp_node(struct simtemp_dev *d)
+{
+    return d->cpu >= 0 ? cpu_to_node(d->cpu) : NUMA_NO_NODE;
+}
+
+/* ---- Configuration: one struct, replaced atomically ---- */
+
+/* Consistent copy of the configuration; safe from any context */
+static void simtemp_config_read(struct simtemp_dev *d, struct simtemp_config *c)
+{
+    unsigned int seq;
+
+    do {
+        seq = read_seqbegin(&d->cfg_seq);
+        *c = d->cfg;
+    } while (read_seqretry(&d->cfg_seq, seq));
+}
+
+/* Publish @c as a whole. Caller holds cfg_lock and has validated it. */
+static void simtemp_config_store(struct simtemp_dev *d, const struct simtemp_config *c)
+{
+    unsigned long irqflags;
+
+    write_seqlock_irqsave(&d->cfg_seq, irqflags);
+    d->cfg = *c;
+    d->period = us_to_ktime(c->period_us);
+    write_sequnlock_irqrestore(&d->cfg_seq, irqflags);
+
+    trace_simtemp_config(d->name, c->period_us, c->threshold_mC, c->mode,
+                         c->burst, c->wakeup_watermark, c->wakeup_latency_us,
+                         c->window_us);
+}
+
+static int simtemp_config_check(struct simtemp_dev *d, const struct simtemp_config *c)
+{
+    if (c->period_us < SIMTEMP_PERIOD_US_MIN || c->period_us > SIMTEMP_PERIOD_US_MAX ||
+        c->threshold_mC < -50000 || c->threshold_mC > 150000 ||
+        c->mode > SIMTEMP_MODE_REPLAY ||
+        c->wave_amplitude_mC > SIMTEMP_WAVE_AMP_MAX ||
+        c->wave_period_us < SIMTEMP_WAVE_US_MIN || c->wave_period_us > SIMTEMP_WAVE_US_MAX ||
+        c->burst < 1 || c->burst > SIMTEMP_BURST_MAX || c->burst > rb_capacity(d) ||
+        c->wakeup_watermark < 1 || c->wakeup_watermark > rb_capacity(d) ||
+        c->wakeup_latency_us > SIMTEMP_WAKE_LATENCY_US_MAX ||
+        c->timer_slack_us > SIMTEMP_PERIOD_US_MAX ||
+        c->deadband_mC > SIMTEMP_DEADBAND_MC_MAX ||
+        c->heartbeat_us > SIMTEMP_HEARTBEAT_US_MAX ||
+        (c->window_us &&
+         (c->window_us < SIMTEMP_WINDOW_US_MIN || c->window_us > SIMTEMP_WINDOW_US_MAX)) ||
+        memchr_inv(c->reserved, 0, sizeof(c->reserved)))
+        return -EINVAL;
+    return 0;
+}
+
+/*
+ * ---- Ring reallocation ----
+ * Replace the ring of @d with an empty one of @size slots on the
+ * producer's node. Caller holds cfg_lock and ring_lock, has checked that
+ * no file is open and has stopped the producer.
+ */
+static int simtemp_ring_realloc(struct simtemp_dev *d, u32 size)
+{
+    struct simtemp_ring_ctrl *ctrl, *old = d->ctrl;
+    struct simtemp_config cfg;
+    int node = simtemp_node(d);
+    size_t bytes;
+
+    ctrl = rb_alloc(size, node, &bytes);
+    if (!ctrl)
+        return -ENOMEM;
+
+    rb_install(d, ctrl, size, bytes);
+    d->ring_node = node;
+    atomic_set(&d->high_water, 0);  /* measured against the old capacity */
+    if (d->batch_min > rb_capacity(d))
+        d->batch_min = rb_capacity(d);
+    d->wake_head = 0;
+
+    /* a smaller ring may no longer hold a whole burst or watermark */
+    cfg = d->cfg;
+    cfg.burst = min(cfg.burst, rb_capacity(d));
+    cfg.wakeup_watermark = min(cfg.wakeup_watermark, rb_capacity(d));
+    simtemp_config_store(d, &cfg);
+
+    vfree(old);
+    return 0;
+}
+
+/* ---- Producer control: only one of timer/work may push at a time ---- */
+static void simtemp_producer_stop(struct simtemp_dev *d)
+{
+    hrtimer_cancel(&d->timer);
+    cancel_work_sync(&d->work);
+    hrtimer_cancel(&d->flush_timer);
+}
+
+/*
+ * With timer_slack_us the expiry may be deferred by up to that much, so
+ * the hrtimer core can serve it from an interrupt another timer raised
+ * anyway: slow sensors of a large fleet then share a handful of wakeups.
+ * hrtimer_forward_now() keeps the range on every later expiry. Without a
+ * CPU preference such a timer is not pinned either, leaving timer
+ * migration free to move it off idle CPUs.
+ */
+static void simtemp_timer_start_local(void *arg)
+{
+    struct simtemp_dev *d = arg;
+    u64 slack_ns = (u64)min(d->cfg.timer_slack_us, d->cfg.period_us) * NSEC_PER_USEC;
+
+    d->last_fire_ns = 0;    /* the first interval after a (re)start is not a period */
+    hrtimer_start_range_ns(&d->timer, d->period, slack_ns,
+                           d->cpu < 0 && slack_ns ? HRTIMER_MODE_REL
+                                                  : HRTIMER_MODE_REL_PINNED);
+}
+
+/* A pinned hrtimer stays on the CPU that started it: start it from d->cpu */
+static void simtemp_producer_start(struct simtemp_dev *d)
+{
+    if (d->cpu >= 0 &&
+        !smp_call_function_single(d->cpu, simtemp_timer_start_local, d, 1))
+        return;
+    /* no preference, or the CPU went offline: stay where we are */
+    simtemp_timer_start_local(d);
+}
+
+/*
+ * Validate and apply a whole new configuration; all or nothing. The timer
+ * is only restarted when the period or its slack changes, everything else
+ * is picked up at the next expiry. Caller holds cfg_lock.
+ */
+static int simtemp_config_apply(struct simtemp_dev *d, const struct simtemp_config *c)
+{
+    bool restart = c->period_us != d->cfg.period_us ||
+                   c->timer_slack_us != d->cfg.timer_slack_us;
+    int ret;
+
+    ret = simtemp_config_check(d, c);
+    if (ret)
+        return ret;
+
+    if (restart)
+        simtemp_producer_stop(d);
+    simtemp_config_store(d, c);
+    if (restart)
+        simtemp_producer_start(d);
+    return 0;
 }
 
 /* ---- Sysfs attribute handlers ---- */
@@ -92,27 +749,126 @@ static inline bool rb_pop(struct simtemp_dev *d, struct simtemp_sample *out)
 static ssize_t sampling_ms_show(struct device *dev, 
                                 struct device_attribute *attr, char *buf)
 {
-    return sprintf(buf, "%d\n", gdev->period_ms);
+    struct simtemp_dev *d = to_simtemp(dev);
+
+    /* sub-millisecond periods read back as 0: use sampling_us for those */
+    return sprintf(buf, "%u\n", d->cfg.period_us / 1000);
 }
 
 static ssize_t sampling_ms_store(struct device *dev,
                                  struct device_attribute *attr,
                                  const char *buf, size_t count)
 {
-    int ms;
+    struct simtemp_dev *d = to_simtemp(dev);
+    struct simtemp_config c;
+    int ms, ret;
     
     /* validate input: must be between 1ms and 10 seconds */
     if (kstrtoint(buf, 10, &ms) || ms < 1 || ms > 10000)
         return -EINVAL;
     
-    /* update period and restart timer */
-    gdev->period_ms = ms;
-    gdev->period = ms_to_ktime(ms);
-    
-    /* restart timer with new period */
-    hrtimer_cancel(&gdev->timer);
-    hrtimer_start(&gdev->timer, gdev->period, HRTIMER_MODE_REL_PINNED);
+    /* update period; the timer restarts only if it actually changed */
+    mutex_lock(&d->cfg_lock);
+    c = d->cfg;
+    c.period_us = ms * 1000;
+    ret = simtemp_config_apply(d, &c);
+    mutex_unlock(&d->cfg_lock);
     
+    return ret ? ret : count;
+}
+
+/* sampling_us: sampling period in microseconds, for rates above 1 kHz */
+static ssize_t sampling_us_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+
+    return sprintf(buf, "%u\n", d->cfg.period_us);
+}
+
+static ssize_t sampling_us_store(struct device *dev,
+                                 struct device_attribute *attr,
+                                 const char *buf, size_t count)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+    struct simtemp_config c;
+    unsigned int us;
+    int ret;
+
+    if (kstrtouint(buf, 10, &us))
+        return -EINVAL;
+
+    mutex_lock(&d->cfg_lock);
+    c = d->cfg;
+    c.period_us = us;
+    ret = simtemp_config_apply(d, &c);
+    mutex_unlock(&d->cfg_lock);
+
+    return ret ? ret : count;
+}
+
+/* burst: samples generated (and published together) per timer expiry */
+static ssize_t burst_show(struct device *dev,
+                          struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+
+    return sprintf(buf, "%u\n", d->cfg.burst);
+}
+
+static ssize_t burst_store(struct device *dev,
+                           struct device_attribute *attr,
+                           const char *buf, size_t count)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+    struct simtemp_config c;
+    unsigned int n;
+    int ret;
+
+    if (kstrtouint(buf, 10, &n))
+        return -EINVAL;
+
+    /* the producer picks it up at its next expiry, no restart needed */
+    mutex_lock(&d->cfg_lock);
+    c = d->cfg;
+    c.burst = n;    /* must fit in the ring */
+    ret = simtemp_config_apply(d, &c);
+    mutex_unlock(&d->cfg_lock);
+
+    return ret ? ret : count;
+}
+
+/* producer: "work" (process context) or "timer" (straight from the hrtimer) */
+static ssize_t producer_show(struct device *dev,
+                             struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+
+    return sprintf(buf, "%s\n",
+                   d->producer == SIMTEMP_PRODUCER_TIMER ? "timer" : "work");
+}
+
+static ssize_t producer_store(struct device *dev,
+                              struct device_attribute *attr,
+                              const char *buf, size_t count)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+    int producer;
+
+    if (sysfs_streq(buf, "work"))
+        producer = SIMTEMP_PRODUCER_WORK;
+    else if (sysfs_streq(buf, "timer"))
+        producer = SIMTEMP_PRODUCER_TIMER;
+    else
+        return -EINVAL;
+
+    /* the ring has a single writer: never let timer and work overlap */
+    mutex_lock(&d->cfg_lock);
+    simtemp_producer_stop(d);
+    d->producer = producer;
+    simtemp_producer_start(d);
+    mutex_unlock(&d->cfg_lock);
+
     return count;
 }
 
@@ -120,31 +876,51 @@ static ssize_t sampling_ms_store(struct device *dev,
 static ssize_t threshold_mC_show(struct device *dev,
                                 struct device_attribute *attr, char *buf)
 {
-    return sprintf(buf, "%d\n", gdev->threshold_mC);
+    struct simtemp_dev *d = to_simtemp(dev);
+
+    return sprintf(buf, "%d\n", d->cfg.threshold_mC);
 }
 
 static ssize_t threshold_mC_store(struct device *dev,
                                   struct device_attribute *attr,
                                   const char *buf, size_t count)
 {
+    struct simtemp_dev *d = to_simtemp(dev);
+    struct simtemp_config c;
     s32 mC;
+    int ret;
     
-    /* validate input: reasonable temperature range */
-    if (kstrtos32(buf, 10, &mC) || mC < -50000 || mC > 150000)
+    if (kstrtos32(buf, 10, &mC))
         return -EINVAL;
     
-    gdev->threshold_mC = mC;
-    return count;
+    /* range (reasonable temperatures) is checked with the rest of cfg */
+    mutex_lock(&d->cfg_lock);
+    c = d->cfg;
+    c.threshold_mC = mC;
+    ret = simtemp_config_apply(d, &c);
+    mutex_unlock(&d->cfg_lock);
+
+    return ret ? ret : count;
 }
 
 /* mode: temperature generation mode */
+static const char * const simtemp_mode_names[] = {
+    [SIMTEMP_MODE_NORMAL] = "normal",
+    [SIMTEMP_MODE_NOISY]  = "noisy",
+    [SIMTEMP_MODE_RAMP]   = "ramp",
+    [SIMTEMP_MODE_SINE]   = "sine",
+    [SIMTEMP_MODE_STEP]   = "step",
+    [SIMTEMP_MODE_SAW]    = "saw",
+    [SIMTEMP_MODE_REPLAY] = "replay",
+};
+
 static ssize_t mode_show(struct device *dev,
                          struct device_attribute *attr, char *buf)
 {
-    const char *mode_str[] = {"normal", "noisy", "ramp"};
+    struct simtemp_dev *d = to_simtemp(dev);
     
-    if (gdev->mode >= 0 && gdev->mode < 3)
-        return sprintf(buf, "%s\n", mode_str[gdev->mode]);
+    if (d->cfg.mode < ARRAY_SIZE(simtemp_mode_names))
+        return sprintf(buf, "%s\n", simtemp_mode_names[d->cfg.mode]);
     else
         return sprintf(buf, "unknown\n");
 }
@@ -153,252 +929,1691 @@ static ssize_t mode_store(struct device *dev,
     struct device_attribute *attr,
     const char *buf, size_t count)
 {
-    int mode;
-    size_t len = count;
-
-    if (len && buf[len-1] == '\n') len--;
+    struct simtemp_dev *d = to_simtemp(dev);
+    struct simtemp_config c;
+    int mode, ret;
 
-    if ((len == 6 && !strncmp(buf, "normal", 6)) || (len == 1 && buf[0] == '0'))
-        mode = 0;
-    else if ((len == 5 && !strncmp(buf, "noisy", 5)) || (len == 1 && buf[0] == '1'))
-        mode = 1;
-    else if ((len == 4 && !strncmp(buf, "ramp", 4)) || (len == 1 && buf[0] == '2'))
-        mode = 2;
-    else
+    /* by name or by number */
+    mode = sysfs_match_string(simtemp_mode_names, buf);
+    if (mode < 0 && (kstrtoint(buf, 10, &mode) || mode < 0 ||
+                     mode >= ARRAY_SIZE(simtemp_mode_names)))
         return -EINVAL;
 
-    gdev->mode = mode;
-    return count;
+    mutex_lock(&d->cfg_lock);
+    c = d->cfg;
+    c.mode = mode;
+    ret = simtemp_config_apply(d, &c);
+    mutex_unlock(&d->cfg_lock);
+
+    return ret ? ret : count;
 }
 
 
-/* stats: read-only statistics */
-static ssize_t stats_show(struct device *dev,
-                          struct device_attribute *attr, char *buf)
+/* batch_min: records a blocking read() waits for before returning */
+static ssize_t batch_min_show(struct device *dev,
+                              struct device_attribute *attr, char *buf)
 {
-    return sprintf(buf, "total_samples=%lld\nthreshold_crossings=%lld\n", 
-                   atomic64_read(&gdev->total_samples),
-                   atomic64_read(&gdev->threshold_crossings));
-}
+    struct simtemp_dev *d = to_simtemp(dev);
 
-/* ---- Device attribute declarations ---- */
-static DEVICE_ATTR_RW(sampling_ms);    /* read-write attribute */
-static DEVICE_ATTR_RW(threshold_mC);   /* read-write attribute */
-static DEVICE_ATTR_RW(mode);           /* read-write attribute */
-static DEVICE_ATTR_RO(stats);          /* read-only attribute */
+    return sprintf(buf, "%d\n", d->batch_min);
+}
 
-/* ---- Producer work: generates one sample and pushes to ring ---- */
-static void simtemp_work_fn(struct work_struct *work)
+static ssize_t batch_min_store(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf, size_t count)
 {
-    struct simtemp_dev *d = gdev;
-    struct simtemp_sample s;
-    unsigned long flags;
+    struct simtemp_dev *d = to_simtemp(dev);
+    int n;
 
-    /* Generate temperature based on configured mode */
-    s.timestamp_ns = ktime_get_ns();
-    s.flags        = 1u;     /* bit0 = NEW_SAMPLE */
-    
-    switch (d->mode) {
-    case 0: /* normal mode: constant temperature */
-        s.temp_mC = 25000;  /* 25°C */
-        break;
-        
-    case 1: /* noisy mode: random temperature */
-        s.temp_mC = 25000 + (get_random_u32() % 10000) - 5000;  /* 20-30°C */
-        break;
-        
-    case 2: /* ramp mode: sawtooth pattern */
-        static s32 ramp = 20000; /* 20.000 °C */
-        ramp += 123;             /* +0.123 °C per sample */
-        if (ramp > 45000) ramp = 20000;
-        s.temp_mC = ramp;
-        break;
-        
-    default:
-        s.temp_mC = 25000;  /* fallback to normal */
-        break;
-    }
-    
-    /* detect threshold crossing (not just being above threshold) */
-    bool currently_above = (s.temp_mC > d->threshold_mC);
-    
-    if (currently_above != d->above_threshold) {
-        /* threshold crossed - set flag and update state */
-        s.flags |= 2u;  /* bit1 = THRESHOLD_CROSSED */
-        d->above_threshold = currently_above;
-        atomic64_inc(&d->threshold_crossings);
-        
-        pr_info("simtemp: threshold crossed %s (temp=%d mC, threshold=%d mC)\n",
-                currently_above ? "UP" : "DOWN", 
-                s.temp_mC, d->threshold_mC);
-    }
+    /* a batch can never be larger than what the ring holds */
+    if (kstrtoint(buf, 10, &n) || n < 1 || n > rb_capacity(d))
+        return -EINVAL;
 
-    spin_lock_irqsave(&d->lock, flags);
-    rb_push(d, &s);
-    spin_unlock_irqrestore(&d->lock, flags);
+    d->batch_min = n;
+    return count;
+}
 
-    atomic64_inc(&d->total_samples);
+/* batch_timeout_ms: upper bound for the batch_min wait (0 = wait forever) */
+static ssize_t batch_timeout_ms_show(struct device *dev,
+                                     struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
 
-    /* Wake up any reader waiting for data */
-    wake_up_interruptible(&d->wq);
+    return sprintf(buf, "%d\n", d->batch_timeout_ms);
 }
 
-/* ---- hrtimer: schedules the work periodically ---- */
-static enum hrtimer_restart simtemp_timer_fn(struct hrtimer *t)
+static ssize_t batch_timeout_ms_store(struct device *dev,
+                                      struct device_attribute *attr,
+                                      const char *buf, size_t count)
 {
-    struct simtemp_dev *d = container_of(t, struct simtemp_dev, timer);
+    struct simtemp_dev *d = to_simtemp(dev);
+    int ms;
 
-    /* Schedule work in process context (keep timer handler minimal) */
-    schedule_work(&d->work);
+    if (kstrtoint(buf, 10, &ms) || ms < 0 || ms > 60000)
+        return -EINVAL;
 
-    /* rearm */
-    hrtimer_forward_now(&d->timer, d->period);
-    return HRTIMER_RESTART;
+    d->batch_timeout_ms = ms;
+    return count;
 }
 
-/* ---- file operations ---- */
-static ssize_t simtemp_read(struct file *file, char __user *buf,
-                            size_t count, loff_t *ppos)
+/*
+ * wakeup_watermark: the producer only wakes the wait queue, and poll()
+ * only reports POLLIN, once this many records are queued
+ */
+static ssize_t wakeup_watermark_show(struct device *dev,
+                                     struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+
+    return sprintf(buf, "%u\n", d->cfg.wakeup_watermark);
+}
+
+static ssize_t wakeup_watermark_store(struct device *dev,
+                                      struct device_attribute *attr,
+                                      const char *buf, size_t count)
 {
-    struct simtemp_dev *d = gdev;
-    struct simtemp_sample s;
-    unsigned long flags;
+    struct simtemp_dev *d = to_simtemp(dev);
+    struct simtemp_config c;
+    unsigned int n;
+    int ret;
 
-    /* we deliver whole records only for now */
-    if (count < sizeof(s))
+    if (kstrtouint(buf, 10, &n))
         return -EINVAL;
 
-    /* Fast path: try pop; if empty, block unless O_NONBLOCK */
-    for (;;) {
-        bool ok;
+    /* a watermark above the capacity would never be reached */
+    mutex_lock(&d->cfg_lock);
+    c = d->cfg;
+    c.wakeup_watermark = n;
+    ret = simtemp_config_apply(d, &c);
+    mutex_unlock(&d->cfg_lock);
 
-        spin_lock_irqsave(&d->lock, flags);
-        ok = rb_pop(d, &s);
-        spin_unlock_irqrestore(&d->lock, flags);
+    return ret ? ret : count;
+}
 
-        if (ok)
-            break;
+/* wakeup_latency_us: deliver below the watermark once data is this old (0 = off) */
+static ssize_t wakeup_latency_us_show(struct device *dev,
+                                      struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
 
-        if (file->f_flags & O_NONBLOCK)
-            return -EAGAIN;
+    return sprintf(buf, "%u\n", d->cfg.wakeup_latency_us);
+}
+
+static ssize_t wakeup_latency_us_store(struct device *dev,
+                                       struct device_attribute *attr,
+                                       const char *buf, size_t count)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+    struct simtemp_config c;
+    unsigned int us;
+    int ret;
+
+    if (kstrtouint(buf, 10, &us))
+        return -EINVAL;
+
+    mutex_lock(&d->cfg_lock);
+    c = d->cfg;
+    c.wakeup_latency_us = us;
+    ret = simtemp_config_apply(d, &c);
+    mutex_unlock(&d->cfg_lock);
+
+    return ret ? ret : count;
+}
+
+/* window_us: aggregation window of SIMTEMP_STREAM_WINDOW readers (0 = off) */
+static ssize_t window_us_show(struct device *dev,
+                              struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+
+    return sprintf(buf, "%u\n", d->cfg.window_us);
+}
+
+static ssize_t window_us_store(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf, size_t count)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+    struct simtemp_config c;
+    unsigned int us;
+    int ret;
+
+    if (kstrtouint(buf, 10, &us))
+        return -EINVAL;
+
+    mutex_lock(&d->cfg_lock);
+    c = d->cfg;
+    c.window_us = us;
+    ret = simtemp_config_apply(d, &c);
+    mutex_unlock(&d->cfg_lock);
+
+    return ret ? ret : count;
+}
+
+/* wave_amplitude_mC / wave_period_us: shape of the sine/step/saw modes */
+static ssize_t wave_amplitude_mC_show(struct device *dev,
+                                      struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+
+    return sprintf(buf, "%u\n", d->cfg.wave_amplitude_mC);
+}
+
+static ssize_t wave_amplitude_mC_store(struct device *dev,
+                                       struct device_attribute *attr,
+                                       const char *buf, size_t count)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+    struct simtemp_config c;
+    unsigned int mC;
+    int ret;
+
+    if (kstrtouint(buf, 10, &mC))
+        return -EINVAL;
+
+    mutex_lock(&d->cfg_lock);
+    c = d->cfg;
+    c.wave_amplitude_mC = mC;
+    ret = simtemp_config_apply(d, &c);
+    mutex_unlock(&d->cfg_lock);
+
+    return ret ? ret : count;
+}
+
+static ssize_t wave_period_us_show(struct device *dev,
+                                   struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+
+    return sprintf(buf, "%u\n", d->cfg.wave_period_us);
+}
+
+static ssize_t wave_period_us_store(struct device *dev,
+                                    struct device_attribute *attr,
+                                    const char *buf, size_t count)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+    struct simtemp_config c;
+    unsigned int us;
+    int ret;
+
+    if (kstrtouint(buf, 10, &us))
+        return -EINVAL;
+
+    mutex_lock(&d->cfg_lock);
+    c = d->cfg;
+    c.wave_period_us = us;
+    ret = simtemp_config_apply(d, &c);
+    mutex_unlock(&d->cfg_lock);
+
+    return ret ? ret : count;
+}
+
+/* deadband_mC / heartbeat_us: send-on-change filter of the producer */
+static ssize_t deadband_mC_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+
+    return sprintf(buf, "%u\n", d->cfg.deadband_mC);
+}
+
+static ssize_t deadband_mC_store(struct device *dev,
+                                 struct device_attribute *attr,
+                                 const char *buf, size_t count)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+    struct simtemp_config c;
+    unsigned int mC;
+    int ret;
+
+    if (kstrtouint(buf, 10, &mC))
+        return -EINVAL;
+
+    mutex_lock(&d->cfg_lock);
+    c = d->cfg;
+    c.deadband_mC = mC;
+    ret = simtemp_config_apply(d, &c);
+    mutex_unlock(&d->cfg_lock);
+
+    return ret ? ret : count;
+}
+
+static ssize_t heartbeat_us_show(struct device *dev,
+                                 struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+
+    return sprintf(buf, "%u\n", d->cfg.heartbeat_us);
+}
+
+static ssize_t heartbeat_us_store(struct device *dev,
+                                  struct device_attribute *attr,
+                                  const char *buf, size_t count)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+    struct simtemp_config c;
+    unsigned int us;
+    int ret;
+
+    if (kstrtouint(buf, 10, &us))
+        return -EINVAL;
+
+    mutex_lock(&d->cfg_lock);
+    c = d->cfg;
+    c.heartbeat_us = us;
+    ret = simtemp_config_apply(d, &c);
+    mutex_unlock(&d->cfg_lock);
+
+    return ret ? ret : count;
+}
+
+/* timer_slack_us: how late the sampling timer may fire to share a wakeup */
+static ssize_t timer_slack_us_show(struct device *dev,
+                                   struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+
+    return sprintf(buf, "%u\n", d->cfg.timer_slack_us);
+}
+
+static ssize_t timer_slack_us_store(struct device *dev,
+                                    struct device_attribute *attr,
+                                    const char *buf, size_t count)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+    struct simtemp_config c;
+    unsigned int us;
+    int ret;
+
+    if (kstrtouint(buf, 10, &us))
+        return -EINVAL;
+
+    mutex_lock(&d->cfg_lock);
+    c = d->cfg;
+    c.timer_slack_us = us;
+    ret = simtemp_config_apply(d, &c);
+    mutex_unlock(&d->cfg_lock);
+
+    return ret ? ret : count;
+}
+
+/*
+ * replay_firmware: load a trace for SIMTEMP_MODE_REPLAY (an empty write
+ * drops it). The new trace is published with RCU: the producer holds the
+ * old one for at most one burst.
+ */
+static ssize_t replay_firmware_show(struct device *dev,
+                                    struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+    const struct simtemp_replay *rp;
+    ssize_t len;
+
+    rcu_read_lock();
+    rp = rcu_dereference(d->replay);
+    len = rp ? sprintf(buf, "%s %u\n", rp->name, rp->count) : sprintf(buf, "\n");
+    rcu_read_unlock();
+    return len;
+}
+
+static ssize_t replay_firmware_store(struct device *dev,
+                                     struct device_attribute *attr,
+                                     const char *buf, size_t count)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+    struct simtemp_replay *rp = NULL, *old;
+    const struct firmware *fw;
+    char name[sizeof(rp->name)];
+    int ret;
+
+    if (strscpy(name, buf, sizeof(name)) < 0)
+        return -ENAMETOOLONG;
+    strim(name);
+
+    if (name[0]) {
+        ret = request_firmware(&fw, name, dev);
+        if (ret)
+            return ret;
+        if (!fw->size || fw->size % sizeof(s32) ||
+            fw->size / sizeof(s32) > SIMTEMP_REPLAY_MAX) {
+            release_firmware(fw);
+            return -EINVAL;
+        }
+        rp = kvmalloc(struct_size(rp, mC, fw->size / sizeof(s32)), GFP_KERNEL);
+        if (!rp) {
+            release_firmware(fw);
+            return -ENOMEM;
+        }
+        rp->count = fw->size / sizeof(s32);
+        strscpy(rp->name, name, sizeof(rp->name));
+        memcpy(rp->mC, fw->data, fw->size);
+        release_firmware(fw);
+    }
+
+    mutex_lock(&d->cfg_lock);
+    old = rcu_dereference_protected(d->replay, lockdep_is_held(&d->cfg_lock));
+    rcu_assign_pointer(d->replay, rp);
+    mutex_unlock(&d->cfg_lock);
+
+    synchronize_rcu();
+    kvfree(old);
+    return count;
+}
+
+/* ring_size: ring capacity in records; only while nobody has the device open */
+static ssize_t ring_size_show(struct device *dev,
+                              struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+
+    return sprintf(buf, "%u\n", d->size);
+}
+
+static ssize_t ring_size_store(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf, size_t count)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+    unsigned int size;
+    int ret = count;
+
+    /* must stay a power of two so slot = seq & mask keeps working */
+    if (kstrtouint(buf, 10, &size) || !rb_size_valid(size))
+        return -EINVAL;
+
+    mutex_lock(&d->cfg_lock);
+    mutex_lock(&d->ring_lock);
+    /* open files hold cursors, mappings the pages of the current ring */
+    if (d->open_count || d->map_count) {
+        ret = -EBUSY;
+        goto out;
+    }
+
+    /* the producer is the only other ring user: park it for the swap */
+    simtemp_producer_stop(d);
+    if (simtemp_ring_realloc(d, size))
+        ret = -ENOMEM;
+    simtemp_producer_start(d);
+out:
+    mutex_unlock(&d->ring_lock);
+    mutex_unlock(&d->cfg_lock);
+    return ret;
+}
+
+/*
+ * cpu: where the producer timer and work run (-1 = anywhere). The ring
+ * follows to that CPU's NUMA node, but only while the device is closed
+ * and unmapped.
+ */
+static ssize_t cpu_show(struct device *dev,
+                        struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+
+    return sprintf(buf, "%d\n", d->cpu);
+}
+
+static ssize_t cpu_store(struct device *dev,
+                         struct device_attribute *attr,
+                         const char *buf, size_t count)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+    int cpu;
+
+    if (kstrtoint(buf, 10, &cpu) || cpu < -1 || cpu >= (int)nr_cpu_ids ||
+        (cpu >= 0 && !cpu_online(cpu)))
+        return -EINVAL;
+
+    mutex_lock(&d->cfg_lock);
+    mutex_lock(&d->ring_lock);
+    simtemp_producer_stop(d);
+    WRITE_ONCE(d->cpu, cpu);
+    /* best effort: on failure the old ring simply stays where it is */
+    if (!d->open_count && !d->map_count && simtemp_node(d) != d->ring_node)
+        simtemp_ring_realloc(d, d->size);
+    simtemp_producer_start(d);
+    mutex_unlock(&d->ring_lock);
+    mutex_unlock(&d->cfg_lock);
+
+    return count;
+}
+
+static void simtemp_stats_read(struct simtemp_dev *d, struct simtemp_stats *st)
+{
+    st->total_samples       = atomic64_read(&d->total_samples);
+    st->threshold_crossings = atomic64_read(&d->threshold_crossings);
+    st->ring_overwrites     = atomic64_read(&d->ring_overwrites);
+    st->reader_overruns     = atomic64_read(&d->reader_overruns);
+    st->wakeups             = atomic64_read(&d->wakeups);
+    st->suppressed          = atomic64_read(&d->suppressed);
+}
+
+/* stats: read-only statistics (SIMTEMP_IOC_GET_STATS is the binary form) */
+static ssize_t stats_show(struct device *dev,
+                          struct device_attribute *attr, char *buf)
+{
+    struct simtemp_dev *d = to_simtemp(dev);
+    struct simtemp_stats st;
+
+    simtemp_stats_read(d, &st);
+    return sprintf(buf, "total_samples=%llu\nthreshold_crossings=%llu\n"
+                   "ring_overwrites=%llu\nreader_overruns=%llu\n"
+                   "wakeups=%llu\nsuppressed=%llu\n"
+                   "timer_overruns=%llu\nring_high_water=%d\n",
+                   st.total_samples, st.threshold_crossings,
+                   st.ring_overwrites, st.reader_overruns, st.wakeups,
+                   st.suppressed, (u64)atomic64_read(&d->timer_overruns),
+                   atomic_read(&d->high_water));
+}
+
+/* ---- Device attribute declarations ---- */
+static DEVICE_ATTR_RW(sampling_ms);    /* read-write attribute */
+static DEVICE_ATTR_RW(sampling_us);    /* read-write attribute */
+static DEVICE_ATTR_RW(producer);       /* read-write attribute */
+static DEVICE_ATTR_RW(burst);          /* read-write attribute */
+static DEVICE_ATTR_RW(threshold_mC);   /* read-write attribute */
+static DEVICE_ATTR_RW(mode);           /* read-write attribute */
+static DEVICE_ATTR_RW(batch_min);      /* read-write attribute */
+static DEVICE_ATTR_RW(batch_timeout_ms); /* read-write attribute */
+static DEVICE_ATTR_RW(wakeup_watermark); /* read-write attribute */
+static DEVICE_ATTR_RW(wakeup_latency_us);
+static DEVICE_ATTR_RW(window_us);
+static DEVICE_ATTR_RW(wave_amplitude_mC);
+static DEVICE_ATTR_RW(wave_period_us);
+static DEVICE_ATTR_RW(replay_firmware);
+static DEVICE_ATTR_RW(timer_slack_us);
+static DEVICE_ATTR_RW(deadband_mC);
+static DEVICE_ATTR_RW(heartbeat_us); /* read-write attribute */
+static DEVICE_ATTR_RW(ring_size);      /* read-write attribute */
+static DEVICE_ATTR_RW(cpu);            /* read-write attribute */
+static DEVICE_ATTR_RO(stats);          /* read-only attribute */
+
+/* created together with each /dev node by misc_register() */
+static struct attribute *simtemp_attrs[] = {
+    &dev_attr_sampling_ms.attr,
+    &dev_attr_sampling_us.attr,
+    &dev_attr_producer.attr,
+    &dev_attr_timer_slack_us.attr,
+    &dev_attr_burst.attr,
+    &dev_attr_threshold_mC.attr,
+    &dev_attr_deadband_mC.attr,
+    &dev_attr_heartbeat_us.attr,
+    &dev_attr_mode.attr,
+    &dev_attr_wave_amplitude_mC.attr,
+    &dev_attr_wave_period_us.attr,
+    &dev_attr_replay_firmware.attr,
+    &dev_attr_batch_min.attr,
+    &dev_attr_batch_timeout_ms.attr,
+    &dev_attr_wakeup_watermark.attr,
+    &dev_attr_wakeup_latency_us.attr,
+    &dev_attr_window_us.attr,
+    &dev_attr_ring_size.attr,
+    &dev_attr_cpu.attr,
+    &dev_attr_stats.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(simtemp);
+
+/* ---- Slow path: log threshold crossings from process context ---- */
+static void simtemp_log_work_fn(struct work_struct *work)
+{
+    struct simtemp_dev *d = container_of(work, struct simtemp_dev, log_work);
+
+    /* the simtemp_threshold tracepoint sees every crossing; the log only samples them */
+    pr_info_ratelimited("%s: threshold crossed %s (temp=%d mC, threshold=%d mC)\n",
+            d->name, READ_ONCE(d->log_up) ? "UP" : "DOWN",
+            READ_ONCE(d->log_temp_mC), READ_ONCE(d->log_threshold_mC));
+}
+
+/* Generate temperature based on configured mode */
+/* What simtemp_generate() needs for one burst, resolved once up front */
+struct simtemp_gen {
+    u32 mode;
+    s32 amplitude_mC;
+    u32 phase_step;                      /* table modes: phase per sample */
+    const struct simtemp_replay *replay; /* replay mode, under rcu_read_lock() */
+};
+
+/* Fill the waveform tables: one cycle each, Q15 */
+static void simtemp_wave_init(void)
+{
+    int i;
+
+    for (i = 0; i < SIMTEMP_WAVE_LEN; i++) {
+        simtemp_wave_tab[0][i] = fixp_sin32_rad(i, SIMTEMP_WAVE_LEN) >> 16;
+        simtemp_wave_tab[1][i] = i < SIMTEMP_WAVE_LEN / 2 ? S16_MAX : -S16_MAX;
+        simtemp_wave_tab[2][i] = -S16_MAX + (2 * S16_MAX * i) / (SIMTEMP_WAVE_LEN - 1);
+    }
+}
+
+static void simtemp_gen_prepare(struct simtemp_dev *d, const struct simtemp_config *c,
+                                struct simtemp_gen *g)
+{
+    g->mode = c->mode;
+    g->amplitude_mC = c->wave_amplitude_mC;
+    /* samples are period_us / burst apart: 2^32 * spacing / wave period */
+    g->phase_step = div64_u64((u64)c->period_us << 32, (u64)c->wave_period_us * c->burst);
+    g->replay = c->mode == SIMTEMP_MODE_REPLAY ? rcu_dereference(d->replay) : NULL;
+}
+
+/* xorshift32: a few cycles and no shared state, unlike get_random_u32() */
+static inline u32 simtemp_prng(struct simtemp_dev *d)
+{
+    u32 x = d->prng;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    d->prng = x;
+    return x;
+}
+
+/* Generate temperature based on configured mode; constant cost in every mode */
+static s32 simtemp_generate(struct simtemp_dev *d, const struct simtemp_gen *g)
+{
+    const struct simtemp_replay *rp;
+    s16 q;
+
+    switch (g->mode) {
+    case SIMTEMP_MODE_NORMAL: /* normal mode: constant temperature */
+        return SIMTEMP_BASE_MC;  /* 25°C */
+        
+    case SIMTEMP_MODE_NOISY: /* noisy mode: uniform 20-30°C */
+        return SIMTEMP_BASE_MC - 5000 + (s32)(((u64)simtemp_prng(d) * 10000) >> 32);
+        
+    case SIMTEMP_MODE_RAMP: /* ramp mode: sawtooth pattern */
+        d->ramp_mC += 123;       /* +0.123 °C per sample */
+        if (d->ramp_mC > 45000) d->ramp_mC = 20000;
+        return d->ramp_mC;
+
+    case SIMTEMP_MODE_SINE:
+    case SIMTEMP_MODE_STEP:
+    case SIMTEMP_MODE_SAW:
+        q = simtemp_wave_tab[g->mode - SIMTEMP_MODE_SINE]
+                            [d->wave_phase >> (32 - SIMTEMP_WAVE_SHIFT)];
+        d->wave_phase += g->phase_step;
+        return SIMTEMP_BASE_MC + ((g->amplitude_mC * q) >> 15);
+
+    case SIMTEMP_MODE_REPLAY:
+        rp = g->replay;
+        if (!rp)
+            return SIMTEMP_BASE_MC;
+        if (d->replay_pos >= rp->count)
+            d->replay_pos = 0;       /* looped, or a shorter trace came in */
+        return rp->mC[d->replay_pos++];
+        
+    default:
+        return SIMTEMP_BASE_MC;  /* fallback to normal */
+    }
+}
+
+/* ---- Threshold events: one short spinlock section per crossing ---- */
+static void simtemp_push_event(struct simtemp_dev *d, const struct simtemp_sample *s,
+                               u32 seq, s32 threshold_mC, bool up)
+{
+    struct simtemp_event *ev;
+    unsigned long irqflags;
+
+    spin_lock_irqsave(&d->ev_lock, irqflags);
+    ev = &d->events[d->ev_head & (SIMTEMP_EVENT_QUEUE - 1)];
+    ev->timestamp_ns = s->timestamp_ns;
+    ev->seq          = seq;
+    ev->temp_mC      = s->temp_mC;
+    ev->threshold_mC = threshold_mC;
+    ev->flags        = up ? SIMTEMP_EVENT_RISING : 0;
+    WRITE_ONCE(d->ev_head, d->ev_head + 1);
+    spin_unlock_irqrestore(&d->ev_lock, irqflags);
+}
+
+static bool simtemp_event_pending(struct simtemp_dev *d, struct simtemp_file *f)
+{
+    return READ_ONCE(d->ev_head) != READ_ONCE(f->ev_cursor);
+}
+
+/* Take the oldest event queued for @f; false if there is none */
+static bool simtemp_pop_event(struct simtemp_dev *d, struct simtemp_file *f,
+                              struct simtemp_event *out)
+{
+    unsigned long irqflags;
+    bool lost = false;
+
+    spin_lock_irqsave(&d->ev_lock, irqflags);
+    if (d->ev_head == f->ev_cursor) {
+        spin_unlock_irqrestore(&d->ev_lock, irqflags);
+        return false;
+    }
+    if (d->ev_head - f->ev_cursor > SIMTEMP_EVENT_QUEUE) {
+        f->ev_cursor = d->ev_head - SIMTEMP_EVENT_QUEUE;
+        lost = true;
+    }
+    *out = d->events[f->ev_cursor & (SIMTEMP_EVENT_QUEUE - 1)];
+    WRITE_ONCE(f->ev_cursor, f->ev_cursor + 1);
+    spin_unlock_irqrestore(&d->ev_lock, irqflags);
+
+    if (lost)
+        out->flags |= SIMTEMP_EVENT_OVERRUN;
+    return true;
+}
+
+/* ---- Windowed aggregation ---- */
+static void simtemp_push_window(struct simtemp_dev *d)
+{
+    struct simtemp_window *w;
+    unsigned long irqflags;
+
+    spin_lock_irqsave(&d->win_lock, irqflags);
+    w = &d->windows[d->win_head & (SIMTEMP_WINDOW_QUEUE - 1)];
+    w->start_ns  = d->win_start_ns;
+    w->end_ns    = d->win_end_ns;
+    w->min_mC    = d->win_min;
+    w->max_mC    = d->win_max;
+    w->mean_mC   = div_s64(d->win_sum, d->win_count);
+    w->count     = d->win_count;
+    w->crossings = d->win_crossings;
+    w->flags     = 0;
+    WRITE_ONCE(d->win_head, d->win_head + 1);
+    spin_unlock_irqrestore(&d->win_lock, irqflags);
+}
+
+/*
+ * Fold @s into the open window; true if that closed the previous one.
+ * Windows close on the first sample past their end, so a summary is
+ * delivered at most one period late and never splits a window.
+ */
+static bool simtemp_window_add(struct simtemp_dev *d, u32 window_us,
+                               const struct simtemp_sample *s)
+{
+    bool closed = false;
+
+    if (!window_us) {
+        d->win_count = 0;
+        d->win_us = 0;
+        return false;
+    }
+
+    if (window_us != d->win_us || s->timestamp_ns >= d->win_end_ns) {
+        u64 len = (u64)window_us * NSEC_PER_USEC;
+        u64 rem;
+
+        if (d->win_count) {
+            simtemp_push_window(d);
+            closed = true;
+        }
+        div64_u64_rem(s->timestamp_ns, len, &rem);
+        d->win_start_ns  = s->timestamp_ns - rem;
+        d->win_end_ns    = d->win_start_ns + len;
+        d->win_us        = window_us;
+        d->win_sum       = 0;
+        d->win_min       = S32_MAX;
+        d->win_max       = S32_MIN;
+        d->win_count     = 0;
+        d->win_crossings = 0;
+    }
+
+    d->win_sum += s->temp_mC;
+    d->win_min = min(d->win_min, s->temp_mC);
+    d->win_max = max(d->win_max, s->temp_mC);
+    d->win_count++;
+    if (s->flags & SIMTEMP_FLAG_THRESHOLD)
+        d->win_crossings++;
+    return closed;
+}
+
+static bool simtemp_window_pending(struct simtemp_dev *d, struct simtemp_file *f)
+{
+    return READ_ONCE(d->win_head) != READ_ONCE(f->win_cursor);
+}
+
+/*
+ * Copy the oldest window queued for @f without consuming it: the caller
+ * advances win_cursor once the record reached user space. False if none.
+ */
+static bool simtemp_peek_window(struct simtemp_dev *d, struct simtemp_file *f,
+                                struct simtemp_window *out)
+{
+    unsigned long irqflags;
+    bool lost = false;
+
+    spin_lock_irqsave(&d->win_lock, irqflags);
+    if (d->win_head == f->win_cursor) {
+        spin_unlock_irqrestore(&d->win_lock, irqflags);
+        return false;
+    }
+    if (d->win_head - f->win_cursor > SIMTEMP_WINDOW_QUEUE) {
+        WRITE_ONCE(f->win_cursor, d->win_head - SIMTEMP_WINDOW_QUEUE);
+        lost = true;
+    }
+    *out = d->windows[f->win_cursor & (SIMTEMP_WINDOW_QUEUE - 1)];
+    spin_unlock_irqrestore(&d->win_lock, irqflags);
+
+    if (lost)
+        out->flags |= SIMTEMP_WINDOW_OVERRUN;
+    return true;
+}
+
+/*
+ * Detect threshold crossing (not just being above threshold) on the
+ * sample with ring sequence @seq; true if it crossed.
+ */
+static bool simtemp_check_threshold(struct simtemp_dev *d, struct simtemp_sample *s,
+                                    u32 seq, s32 threshold_mC)
+{
+    bool currently_above = (s->temp_mC > threshold_mC);
+    
+    if (currently_above == d->above_threshold)
+        return false;
+
+    /* threshold crossed - set flag and update state */
+    s->flags |= SIMTEMP_FLAG_THRESHOLD;
+    d->above_threshold = currently_above;
+    atomic64_inc(&d->threshold_crossings);
+    trace_simtemp_threshold(d->name, seq, s->temp_mC, threshold_mC, currently_above);
+
+    /* printk is far too slow for the sampling path */
+    WRITE_ONCE(d->log_up, currently_above);
+    WRITE_ONCE(d->log_temp_mC, s->temp_mC);
+    WRITE_ONCE(d->log_threshold_mC, threshold_mC);
+    schedule_work(&d->log_work);
+
+    simtemp_push_event(d, s, seq, threshold_mC, currently_above);
+    return true;
+}
+
+/* ---- Wakeup coalescing ---- */
+static void simtemp_wake(struct simtemp_dev *d, u32 head)
+{
+    trace_simtemp_reader_wake(d->name, head, head - READ_ONCE(d->wake_head));
+    WRITE_ONCE(d->wake_head, head);
+    atomic64_inc(&d->wakeups);
+    wake_up_interruptible_poll(&d->wq, EPOLLIN | EPOLLRDNORM);
+}
+
+/*
+ * Called after every publish. Wake the readers only once wake_mark records
+ * piled up since the last wakeup; below that, arm flush_timer so the first
+ * unannounced record is delivered within wake_latency_us anyway.
+ */
+static void simtemp_notify(struct simtemp_dev *d, const struct simtemp_config *c,
+                           u32 head)
+{
+    u32 latency_us = c->wakeup_latency_us;
+
+    if (head - READ_ONCE(d->wake_head) >= c->wakeup_watermark) {
+        simtemp_wake(d, head);
+        return;
+    }
+    if (latency_us && !hrtimer_is_queued(&d->flush_timer))
+        hrtimer_start(&d->flush_timer, us_to_ktime(latency_us),
+                      HRTIMER_MODE_REL_PINNED);   /* wake from the producer CPU */
+}
+
+static enum hrtimer_restart simtemp_flush_timer_fn(struct hrtimer *t)
+{
+    struct simtemp_dev *d = container_of(t, struct simtemp_dev, flush_timer);
+    u32 head = smp_load_acquire(&d->ctrl->head);
+
+    /* the watermark may have been reached meanwhile */
+    if (head != READ_ONCE(d->wake_head))
+        simtemp_wake(d, head);
+    return HRTIMER_NORESTART;
+}
+
+/*
+ * Deadband: publish @s only if it moved deadband_mC away from the last
+ * published value, crossed the threshold, or heartbeat_us passed without
+ * any record. Threshold detection and windows still see every sample.
+ */
+static bool simtemp_deadband_pass(struct simtemp_dev *d, const struct simtemp_config *c,
+                                  const struct simtemp_sample *s)
+{
+    if (c->deadband_mC && d->db_valid &&
+        abs(s->temp_mC - d->db_last_mC) < c->deadband_mC &&
+        !(s->flags & SIMTEMP_FLAG_THRESHOLD) &&
+        !(c->heartbeat_us &&
+          s->timestamp_ns - d->db_last_ns >= (u64)c->heartbeat_us * NSEC_PER_USEC))
+        return false;
+
+    d->db_valid = true;
+    d->db_last_mC = s->temp_mC;
+    d->db_last_ns = s->timestamp_ns;
+    return true;
+}
+
+/*
+ * ---- Producer: generates a burst of samples and pushes them to the ring ----
+ * Runs either from the work item or directly in hrtimer context, so it
+ * must not sleep; anything slow is handed to log_work.
+ *
+ * The burst covers the period ending at @timestamp_ns: sample i of n is
+ * stamped (n - 1 - i) * period / n earlier, so the stream stays uniformly
+ * spaced. An expiry that comes early relative to the previous one (jitter,
+ * timer_slack_us) would reach back into the last burst; the burst is then
+ * squeezed into what is left after it, keeping the stream monotonic.
+ *
+ * The burst is generated into d->stage first, so that only the records
+ * the deadband keeps are reserved in the ring: dropped candidates neither
+ * push the tail nor look torn to readers. The survivors are exposed
+ * together, with a single head store and a single wakeup.
+ */
+static void simtemp_produce(struct simtemp_dev *d, u64 timestamp_ns, u64 expiry_ns)
+{
+    u64 gen_ns = ktime_get_ns();
+    struct simtemp_config c;
+    struct simtemp_gen g;
+    bool crossed = false, closed = false;
+    u32 head, i, n, kept = 0;
+    u64 first, step;
+
+    simtemp_hist_add(d, SIMTEMP_LAT_EXPIRY_TO_GEN, gen_ns - expiry_ns);
+
+    /* one snapshot per burst: a concurrent SET never tears it */
+    simtemp_config_read(d, &c);
+    n = c.burst;
+    step = div_u64((u64)c.period_us * NSEC_PER_USEC, n);
+    first = timestamp_ns - (u64)(n - 1) * step;
+    if (n > 1 && first <= d->last_stamp_ns) {
+        first = d->last_stamp_ns + 1;
+        step = timestamp_ns > first + n - 1 ? div_u64(timestamp_ns - first, n - 1) : 1;
+    }
+
+    /* the replay trace may be swapped by sysfs: hold it for the burst */
+    rcu_read_lock();
+    simtemp_gen_prepare(d, &c, &g);
+    /* producer-only: the sequence rb_reserve() is going to return */
+    head = d->ctrl->head;
+    for (i = 0; i < n; i++) {
+        struct simtemp_sample *s = &d->stage[kept];
+
+        s->timestamp_ns = first + (u64)i * step;
+        s->temp_mC      = simtemp_generate(d, &g);
+        s->flags        = SIMTEMP_FLAG_NEW_SAMPLE;
+        crossed |= simtemp_check_threshold(d, s, head + kept, c.threshold_mC);
+        closed |= simtemp_window_add(d, c.window_us, s);
+        if (!simtemp_deadband_pass(d, &c, s))
+            continue;
+        trace_simtemp_sample(d->name, head + kept, s->timestamp_ns, s->temp_mC, s->flags);
+        kept++;
+    }
+    rcu_read_unlock();
+    if (kept) {
+        head = rb_reserve(d, kept);
+        for (i = 0; i < kept; i++)
+            *rb_slot(d, head + i) = d->stage[i];
+        rb_commit(d, head, kept);
+    }
+    d->last_stamp_ns = first + (u64)(n - 1) * step;
+    simtemp_hist_add(d, SIMTEMP_LAT_GEN_TO_PUBLISH, ktime_get_ns() - gen_ns);
+
+    atomic64_add(n, &d->total_samples);
+    if (kept != n)
+        atomic64_add(n - kept, &d->suppressed);
+
+    /* events bypass the watermark: alerting must not wait for a batch */
+    if (crossed) {
+        wake_up_interruptible(&d->ev_wq);
+        wake_up_interruptible_poll(&d->wq, EPOLLPRI);
+    }
+    /* at most one summary per window: not worth coalescing */
+    if (closed)
+        wake_up_interruptible_poll(&d->wq, EPOLLIN | EPOLLRDNORM);
+
+    /* Wake up readers waiting for data, coalesced up to the watermark */
+    simtemp_notify(d, &c, head + kept);
+}
+
+static void simtemp_work_fn(struct work_struct *work)
+{
+    struct simtemp_dev *d = container_of(work, struct simtemp_dev, work);
+
+    /* stamp with the expiry that queued us, not with when we got to run */
+    simtemp_produce(d, READ_ONCE(d->fired_ns), READ_ONCE(d->expiry_ns));
+}
+
+/* ---- hrtimer: produces the sample itself or hands it to the work ---- */
+static enum hrtimer_restart simtemp_timer_fn(struct hrtimer *t)
+{
+    struct simtemp_dev *d = container_of(t, struct simtemp_dev, timer);
+    u64 expiry = ktime_to_ns(hrtimer_get_expires(t));
+    u64 now = ktime_get_ns();
+    u64 missed;
+
+    if (d->last_fire_ns)
+        simtemp_hist_add(d, SIMTEMP_LAT_PERIOD_ERROR,
+                         abs((s64)(now - d->last_fire_ns) - ktime_to_ns(d->period)));
+    d->last_fire_ns = now;
+
+    if (d->producer == SIMTEMP_PRODUCER_TIMER) {
+        /* fast mode: no scheduler hop between expiry and the ring */
+        simtemp_produce(d, now, expiry);
+    } else {
+        /* Schedule work in process context (keep timer handler minimal) */
+        WRITE_ONCE(d->fired_ns, now);
+        WRITE_ONCE(d->expiry_ns, expiry);
+        /* still pending from the last expiry: this period's burst is lost */
+        if (!queue_work_on(d->cpu >= 0 ? d->cpu : WORK_CPU_UNBOUND, simtemp_wq, &d->work))
+            atomic64_inc(&d->timer_overruns);
+    }
+
+    /* rearm; more than one period forward means expiries were missed */
+    missed = hrtimer_forward_now(&d->timer, d->period);
+    if (missed > 1)
+        atomic64_add(missed - 1, &d->timer_overruns);
+    return HRTIMER_RESTART;
+}
+
+/* ---- file operations ---- */
+
+/*
+ * A blocked read() sits on the shared wait queue with its own wake
+ * function, so the producer only wakes the readers whose cursor has at
+ * least @need records queued; the others stay asleep.
+ */
+struct simtemp_waiter {
+    struct wait_queue_entry wait;
+    struct simtemp_dev *dev;
+    struct simtemp_file *f;
+    u32 need;
+};
+
+static int simtemp_wake_fn(struct wait_queue_entry *wait, unsigned int mode,
+                           int sync, void *key)
+{
+    struct simtemp_waiter *w = container_of(wait, struct simtemp_waiter, wait);
+
+    if (rb_avail(w->dev, w->f) < READ_ONCE(w->need))
+        return 0;
+    return autoremove_wake_function(wait, mode, sync, key);
+}
+
+/*
+ * Block until reader @f has @need records queued. With batch_timeout_ms
+ * set the batch wait is bounded; once it expires we settle for any data.
+ */
+static int simtemp_wait_batch(struct simtemp_dev *d, struct simtemp_file *f, u32 need)
+{
+    struct simtemp_waiter w = { .dev = d, .f = f, .need = need };
+    long timeout = d->batch_timeout_ms ?
+                   msecs_to_jiffies(d->batch_timeout_ms) : MAX_SCHEDULE_TIMEOUT;
+    int ret = 0;
+
+    init_waitqueue_func_entry(&w.wait, simtemp_wake_fn);
+    w.wait.private = current;
+
+    for (;;) {
+        prepare_to_wait(&d->wq, &w.wait, TASK_INTERRUPTIBLE);
+        if (rb_avail(d, f) >= w.need)
+            break;
+        if (signal_pending(current)) {
+            ret = -ERESTARTSYS;
+            break;
+        }
+        timeout = schedule_timeout(timeout);
+        if (!timeout) {
+            /* batch deadline passed: any data will do now */
+            WRITE_ONCE(w.need, 1);
+            timeout = MAX_SCHEDULE_TIMEOUT;
+        }
+    }
+    finish_wait(&d->wq, &w.wait);
+    return ret;
+}
+
+/* read() of a SIMTEMP_STREAM_WINDOW file: whole simtemp_window records */
+static ssize_t simtemp_read_windows(struct simtemp_dev *d, struct simtemp_file *f,
+                                    struct iov_iter *to, bool nowait)
+{
+    struct simtemp_window w;
+    ssize_t done = 0;
+
+    if (iov_iter_count(to) < sizeof(w))
+        return -EINVAL;
+
+    if (nowait) {
+        if (!mutex_trylock(&f->read_lock))
+            return -EAGAIN;
+    } else if (mutex_lock_interruptible(&f->read_lock)) {
+        return -ERESTARTSYS;
+    }
+
+    while (iov_iter_count(to) >= sizeof(w)) {
+        if (!simtemp_peek_window(d, f, &w)) {
+            if (done)
+                break;
+            if (nowait) {
+                done = -EAGAIN;
+                break;
+            }
+            if (wait_event_interruptible(d->wq, simtemp_window_pending(d, f))) {
+                done = -ERESTARTSYS;
+                break;
+            }
+            continue;
+        }
+        if (copy_to_iter(&w, sizeof(w), to) != sizeof(w)) {
+            if (!done)
+                done = -EFAULT;
+            break;
+        }
+        WRITE_ONCE(f->win_cursor, f->win_cursor + 1);
+        done += sizeof(w);
+    }
+    mutex_unlock(&f->read_lock);
+    return done;
+}
+
+/*
+ * read(), readv(), io_uring and splice() all land here. Records are
+ * copied straight from the ring into the caller's segments, so a single
+ * call can hand over up to a full ring and a record may straddle two
+ * iovecs. IOCB_NOWAIT (RWF_NOWAIT, io_uring's first attempt) behaves like
+ * O_NONBLOCK: -EAGAIN instead of sleeping, io_uring then arms poll.
+ */
+static ssize_t simtemp_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+    struct file *file = iocb->ki_filp;
+    struct simtemp_file *f = file->private_data;
+    struct simtemp_dev *d = f->dev;
+    bool nowait = (iocb->ki_flags & IOCB_NOWAIT) || (file->f_flags & O_NONBLOCK);
+    size_t count = iov_iter_count(to);
+    ssize_t ret;
+    u32 want, lost;
+    u64 first_ts;
+
+    if (READ_ONCE(f->stream) == SIMTEMP_STREAM_WINDOW)
+        return simtemp_read_windows(d, f, to, nowait);
+
+    /* we deliver whole records only */
+    want = simtemp_format_fit(f->format, count);
+    if (!want)
+        return -EINVAL;
+
+    if (nowait) {
+        if (!mutex_trylock(&f->read_lock))
+            return -EAGAIN;
+    } else if (mutex_lock_interruptible(&f->read_lock)) {
+        return -ERESTARTSYS;
+    }
+
+    simtemp_note_backlog(d, rb_avail(d, f));
+
+    /* Fast path: drain what's there; if empty, block unless non-blocking */
+    for (;;) {
+        if (f->format == SIMTEMP_FORMAT_V1)
+            ret = rb_read_iter(d, f, to, want, &lost, &first_ts);
+        else
+            ret = rb_read_encoded(d, f, to, &lost, &first_ts);
+        if (ret)
+            break;
+
+        if (nowait) {
+            ret = -EAGAIN;
+            break;
+        }
 
         /* sleep until producer wakes us; handle signals */
-        if (wait_event_interruptible(d->wq, !rb_is_empty(d)))
-            return -ERESTARTSYS;
+        ret = simtemp_wait_batch(d, f, min_t(u32, want, d->batch_min));
+        if (ret)
+            break;
     }
 
-    if (copy_to_user(buf, &s, sizeof(s)))
-        return -EFAULT;
+    if (lost) {
+        f->overruns += lost;
+        atomic64_add(lost, &d->reader_overruns);
+    }
+    if (ret > 0) {
+        trace_simtemp_read(d->name, f->cursor, ret, lost);
+        /* single writer (read_lock); SIMTEMP_IOC_GET_PERF reads them locklessly */
+        WRITE_ONCE(f->delivered, f->delivered + ret);
+        WRITE_ONCE(f->bytes, f->bytes + (count - iov_iter_count(to)));
+        WRITE_ONCE(f->reads, f->reads + 1);
+    }
+    mutex_unlock(&f->read_lock);
+
+    /* age of the oldest record handed over by this call */
+    if (ret > 0)
+        simtemp_hist_add(d, SIMTEMP_LAT_SAMPLE_TO_READ, ktime_get_ns() - first_ts);
 
-    return sizeof(s);
+    return ret > 0 ? count - iov_iter_count(to) : ret;
+}
+
+/*
+ * Records from @seq up to @head are worth a POLLIN once they reach the
+ * watermark, or once the oldest of them has waited wake_latency_us.
+ */
+static bool simtemp_poll_due(struct simtemp_dev *d, u32 seq, u32 head)
+{
+    u32 latency_us = READ_ONCE(d->cfg.wakeup_latency_us);
+    u32 pending = head - seq;
+
+    if (!pending)
+        return false;
+    if (pending >= READ_ONCE(d->cfg.wakeup_watermark))
+        return true;
+    /* below the mark, so never lapped: the oldest slot is still @seq */
+    return latency_us &&
+           ktime_get_ns() - READ_ONCE(rb_slot(d, seq)->timestamp_ns) >=
+           (u64)latency_us * NSEC_PER_USEC;
 }
 
 static __poll_t simtemp_poll(struct file *file, poll_table *wait)
 {
-    struct simtemp_dev *d = gdev;
+    struct simtemp_file *f = file->private_data;
+    struct simtemp_dev *d = f->dev;
     __poll_t mask = 0;
-    unsigned long flags;
 
     /* register interest in the wait queue: if no data, will sleep here */
     poll_wait(file, &d->wq, wait);
 
-    spin_lock_irqsave(&d->lock, flags);
-    if (!rb_is_empty(d))
-        mask |= POLLIN | POLLRDNORM;   // new data available for read
-    spin_unlock_irqrestore(&d->lock, flags);
+    if (simtemp_event_pending(d, f))
+        mask |= POLLPRI;               // threshold crossing queued for this file
+
+    if (READ_ONCE(f->stream) == SIMTEMP_STREAM_WINDOW) {
+        if (simtemp_window_pending(d, f))
+            mask |= POLLIN | POLLRDNORM;
+        return mask;
+    }
+
+    if (READ_ONCE(f->mapped)) {
+        /*
+         * mmap consumers track their own position in user space, so
+         * report each head advance once: they drain up to head and only
+         * come back here when empty.
+         */
+        u32 head = smp_load_acquire(&d->ctrl->head);
+
+        if (simtemp_poll_due(d, f->poll_head, head)) {
+            f->poll_head = head;
+            mask |= POLLIN | POLLRDNORM;
+        }
+        return mask;
+    }
+
+    if (simtemp_poll_due(d, READ_ONCE(f->cursor), smp_load_acquire(&d->ctrl->head)))
+        mask |= POLLIN | POLLRDNORM;   // new data available for this reader
 
     return mask;
 }
 
+/* SIMTEMP_IOC_GET_EVENT: hand out the oldest pending threshold event */
+static long simtemp_ioctl_get_event(struct simtemp_dev *d, struct file *file,
+                                    struct simtemp_event __user *uev)
+{
+    struct simtemp_file *f = file->private_data;
+    struct simtemp_event ev;
+
+    while (!simtemp_pop_event(d, f, &ev)) {
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_event_interruptible(d->ev_wq, simtemp_event_pending(d, f)))
+            return -ERESTARTSYS;
+    }
+
+    return copy_to_user(uev, &ev, sizeof(ev)) ? -EFAULT : 0;
+}
+
+/* SIMTEMP_IOC_SET_CONFIG: replace the whole configuration in one go */
+static long simtemp_ioctl_set_config(struct simtemp_dev *d,
+                                     const struct simtemp_config __user *ucfg)
+{
+    struct simtemp_config c;
+    int ret;
+
+    /* same policy as the (root-only) sysfs attributes */
+    if (!capable(CAP_SYS_ADMIN))
+        return -EPERM;
+    if (copy_from_user(&c, ucfg, sizeof(c)))
+        return -EFAULT;
+
+    if (mutex_lock_interruptible(&d->cfg_lock))
+        return -ERESTARTSYS;
+    ret = simtemp_config_apply(d, &c);
+    mutex_unlock(&d->cfg_lock);
+    return ret;
+}
+
+static long simtemp_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct simtemp_file *f = file->private_data;
+    struct simtemp_dev *d = f->dev;
+    void __user *uarg = (void __user *)arg;
+
+    switch (cmd) {
+    case SIMTEMP_IOC_GET_EVENT:
+        return simtemp_ioctl_get_event(d, file, uarg);
+
+    case SIMTEMP_IOC_GET_CONFIG: {
+        struct simtemp_config c;
+
+        simtemp_config_read(d, &c);
+        return copy_to_user(uarg, &c, sizeof(c)) ? -EFAULT : 0;
+    }
+
+    case SIMTEMP_IOC_SET_CONFIG:
+        return simtemp_ioctl_set_config(d, uarg);
+
+    case SIMTEMP_IOC_GET_STATS: {
+        struct simtemp_stats st;
+
+        simtemp_stats_read(d, &st);
+        return copy_to_user(uarg, &st, sizeof(st)) ? -EFAULT : 0;
+    }
+
+    case SIMTEMP_IOC_GET_PERF: {
+        struct simtemp_perf p = {};
+
+        p.timestamp_ns    = ktime_get_ns();
+        p.total_samples   = atomic64_read(&d->total_samples);
+        p.ring_overwrites = atomic64_read(&d->ring_overwrites);
+        p.wakeups         = atomic64_read(&d->wakeups);
+        p.timer_overruns  = atomic64_read(&d->timer_overruns);
+        p.ring_high_water = atomic_read(&d->high_water);
+        p.readers         = READ_ONCE(d->open_count);
+        p.delivered       = READ_ONCE(f->delivered);
+        p.bytes           = READ_ONCE(f->bytes);
+        p.drops           = READ_ONCE(f->overruns);
+        p.reads           = READ_ONCE(f->reads);
+        return copy_to_user(uarg, &p, sizeof(p)) ? -EFAULT : 0;
+    }
+
+    case SIMTEMP_IOC_SET_STREAM: {
+        u32 stream;
+
+        if (get_user(stream, (u32 __user *)uarg))
+            return -EFAULT;
+        if (stream > SIMTEMP_STREAM_WINDOW)
+            return -EINVAL;
+        /* like a fresh open: only windows closed from now on */
+        mutex_lock(&f->read_lock);
+        WRITE_ONCE(f->win_cursor, READ_ONCE(d->win_head));
+        WRITE_ONCE(f->stream, stream);
+        mutex_unlock(&f->read_lock);
+        return 0;
+    }
+
+    case SIMTEMP_IOC_SET_FORMAT: {
+        u32 format;
+        void *enc = NULL;
+
+        if (get_user(format, (u32 __user *)uarg))
+            return -EFAULT;
+        if (format > SIMTEMP_FORMAT_COMPACT)
+            return -EINVAL;
+        if (format != SIMTEMP_FORMAT_V1 && !f->enc) {
+            enc = kmalloc(SIMTEMP_ENC_BYTES, GFP_KERNEL);
+            if (!enc)
+                return -ENOMEM;
+        }
+        mutex_lock(&f->read_lock);
+        if (enc && !f->enc) {
+            f->enc = enc;
+            enc = NULL;
+        }
+        f->format = format;
+        mutex_unlock(&f->read_lock);
+        kfree(enc);
+        return 0;
+    }
+
+    default:
+        return -ENOTTY;
+    }
+}
+
+/*
+ * Mappings are counted on their own: a ring that is still mapped must not
+ * be swapped, or its reader would watch the old pages forever. open runs
+ * for every copy (fork, split), close for every unmap; the first VMA is
+ * counted by simtemp_mmap() itself.
+ */
+static void simtemp_vm_open(struct vm_area_struct *vma)
+{
+    struct simtemp_dev *d = vma->vm_private_data;
+
+    mutex_lock(&d->ring_lock);
+    d->map_count++;
+    mutex_unlock(&d->ring_lock);
+}
+
+static void simtemp_vm_close(struct vm_area_struct *vma)
+{
+    struct simtemp_dev *d = vma->vm_private_data;
+
+    mutex_lock(&d->ring_lock);
+    d->map_count--;
+    mutex_unlock(&d->ring_lock);
+}
+
+static const struct vm_operations_struct simtemp_vm_ops = {
+    .open  = simtemp_vm_open,
+    .close = simtemp_vm_close,
+};
+
+/* Map the control page + sample area read-only into the caller */
+static int simtemp_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    struct simtemp_file *f = file->private_data;
+    struct simtemp_dev *d = f->dev;
+    unsigned long uaddr, off;
+    int ret;
+
+    /* user space must never scribble over head/tail or the samples */
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+    vm_flags_clear(vma, VM_MAYWRITE);
+
+    /* the requested window must fit inside the ring */
+    if (vma->vm_pgoff > (d->bytes >> PAGE_SHIFT) ||
+        vma->vm_end - vma->vm_start > d->bytes - (vma->vm_pgoff << PAGE_SHIFT))
+        return -EINVAL;
+
+    /* node-local vmalloc pages, inserted one by one like remap_vmalloc_range() */
+    vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+    off = vma->vm_pgoff << PAGE_SHIFT;
+    for (uaddr = vma->vm_start; uaddr < vma->vm_end; uaddr += PAGE_SIZE, off += PAGE_SIZE) {
+        ret = vm_insert_page(vma, uaddr, vmalloc_to_page((void *)d->ctrl + off));
+        if (ret)
+            return ret;
+    }
+
+    vma->vm_private_data = d;
+    vma->vm_ops = &simtemp_vm_ops;
+    simtemp_vm_open(vma);
+
+    f->poll_head = smp_load_acquire(&d->ctrl->head);
+    WRITE_ONCE(f->mapped, true);
+    return 0;
+}
+
+static int simtemp_open(struct inode *inode, struct file *file)
+{
+    /* misc_open() leaves the miscdevice that matched the minor here */
+    struct simtemp_dev *d = container_of(file->private_data, struct simtemp_dev, misc);
+    struct simtemp_file *f;
+
+    f = kzalloc(sizeof(*f), GFP_KERNEL);
+    if (!f)
+        return -ENOMEM;
+
+    /* new readers join the live stream: only samples from now on */
+    mutex_init(&f->read_lock);
+
+    /* pin the current ring: ring_size_store() refuses to swap it now */
+    mutex_lock(&d->ring_lock);
+    d->open_count++;
+    f->cursor = smp_load_acquire(&d->ctrl->head);
+    mutex_unlock(&d->ring_lock);
+    f->ev_cursor = READ_ONCE(d->ev_head);
+    f->dev = d;
+
+    /* read_iter() honours IOCB_NOWAIT, so io_uring may try it inline */
+    file->f_mode |= FMODE_NOWAIT;
+    file->private_data = f;
+    return 0;
+}
+
+static int simtemp_release(struct inode *inode, struct file *file)
+{
+    struct simtemp_file *f = file->private_data;
+    struct simtemp_dev *d = f->dev;
+
+    mutex_lock(&d->ring_lock);
+    d->open_count--;
+    mutex_unlock(&d->ring_lock);
+
+    mutex_destroy(&f->read_lock);
+    kfree(f->enc);
+    kfree(f);
+    return 0;
+}
+
 static const struct file_operations simtemp_fops = {
-    .owner  = THIS_MODULE,
-    .read   = simtemp_read,
-    .poll   = simtemp_poll,
-    .llseek = no_llseek,
+    .owner          = THIS_MODULE,
+    .open           = simtemp_open,
+    .release        = simtemp_release,
+    .read_iter      = simtemp_read_iter,
+    .splice_read    = copy_splice_read,   /* bounces through read_iter() */
+    .poll           = simtemp_poll,
+    .unlocked_ioctl = simtemp_ioctl,
+    .compat_ioctl   = compat_ptr_ioctl,   /* ioctl structs have no pointers */
+    .mmap           = simtemp_mmap,
+    .llseek         = no_llseek,
 };
 
-static struct miscdevice simtemp_miscdev = {
-    .minor = MISC_DYNAMIC_MINOR,
-    .name  = "simtemp",
-    .fops  = &simtemp_fops,
-    .mode  = 0666,
+/* ---- debugfs: latency histograms ---- */
+static int simtemp_latency_show(struct seq_file *m, void *unused)
+{
+    struct simtemp_dev *d = m->private;
+    u64 sum[SIMTEMP_LAT_NR][SIMTEMP_HIST_BUCKETS] = {};
+    int cpu, w, b;
+
+    for_each_possible_cpu(cpu) {
+        struct simtemp_hist *h = per_cpu_ptr(d->hist, cpu);
+
+        for (w = 0; w < SIMTEMP_LAT_NR; w++)
+            for (b = 0; b < SIMTEMP_HIST_BUCKETS; b++)
+                sum[w][b] += READ_ONCE(h->bucket[w][b]);
+    }
+
+    /* one row per non-empty bucket, labelled by its upper bound */
+    seq_printf(m, "%12s", "ns <");
+    for (w = 0; w < SIMTEMP_LAT_NR; w++)
+        seq_printf(m, " %15s", simtemp_lat_names[w]);
+    seq_puts(m, "\n");
+    for (b = 0; b < SIMTEMP_HIST_BUCKETS; b++) {
+        u64 any = 0;
+
+        for (w = 0; w < SIMTEMP_LAT_NR; w++)
+            any |= sum[w][b];
+        if (!any)
+            continue;
+        if (b == SIMTEMP_HIST_BUCKETS - 1)
+            seq_printf(m, "%12s", "inf");
+        else
+            seq_printf(m, "%12llu", 1ULL << b);
+        for (w = 0; w < SIMTEMP_LAT_NR; w++)
+            seq_printf(m, " %15llu", sum[w][b]);
+        seq_puts(m, "\n");
+    }
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(simtemp_latency);
+
+/* any write to reset clears all histograms of the device */
+static ssize_t simtemp_latency_reset_write(struct file *file, const char __user *buf,
+                                           size_t count, loff_t *ppos)
+{
+    struct simtemp_dev *d = file->private_data;
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+        memset(per_cpu_ptr(d->hist, cpu), 0, sizeof(struct simtemp_hist));
+    return count;
+}
+
+static const struct file_operations simtemp_latency_reset_fops = {
+    .owner = THIS_MODULE,
+    .open  = simple_open,
+    .write = simtemp_latency_reset_write,
 };
 
-/* ---- Module init/exit ---- */
-static int __init simtemp_init(void)
+/* debugfs failures are not fatal: the sensor works without its histograms */
+static void simtemp_debugfs_init(struct simtemp_dev *d)
+{
+    d->debugfs = debugfs_create_dir(d->name, simtemp_debugfs_root);
+    debugfs_create_file("latency", 0444, d->debugfs, d, &simtemp_latency_fops);
+    debugfs_create_file("reset", 0200, d->debugfs, d, &simtemp_latency_reset_fops);
+}
+
+/* ---- Instance setup/teardown ---- */
+static void simtemp_destroy(struct simtemp_dev *d)
+{
+    /* unregistering removes sysfs first: its writers restart the producer */
+    debugfs_remove_recursive(d->debugfs);
+    misc_deregister(&d->misc);
+
+    /* then stop the producer */
+    simtemp_producer_stop(d);
+    cancel_work_sync(&d->log_work);
+
+    pr_notice("simtemp: /dev/%s down\n", d->name);
+    kvfree(rcu_dereference_protected(d->replay, true));
+    kvfree(d->stage);
+    free_percpu(d->hist);
+    vfree(d->ctrl);
+    kfree(d);
+}
+
+static struct simtemp_dev *simtemp_create(unsigned int id)
 {
+    struct simtemp_ring_ctrl *ctrl;
+    struct simtemp_dev *d;
+    size_t bytes;
     int ret;
 
-    gdev = kzalloc(sizeof(*gdev), GFP_KERNEL);
-    if (!gdev)
-        return -ENOMEM;
+    d = kzalloc(sizeof(*d), GFP_KERNEL);
+    if (!d)
+        return ERR_PTR(-ENOMEM);
+
+    d->hist = alloc_percpu(struct simtemp_hist);
+    d->stage = kvmalloc_array(SIMTEMP_BURST_MAX, sizeof(*d->stage), GFP_KERNEL);
+    if (!d->hist || !d->stage) {
+        kvfree(d->stage);
+        free_percpu(d->hist);
+        kfree(d);
+        return ERR_PTR(-ENOMEM);
+    }
 
-    spin_lock_init(&gdev->lock);
-    init_waitqueue_head(&gdev->wq);
-    atomic64_set(&gdev->total_samples, 0);
-    atomic64_set(&gdev->threshold_crossings, 0);
+    d->cpu = -1;               /* no placement until sysfs asks for one */
+    ctrl = rb_alloc(ring_size, NUMA_NO_NODE, &bytes);
+    if (!ctrl) {
+        kvfree(d->stage);
+        free_percpu(d->hist);
+        kfree(d);
+        return ERR_PTR(-ENOMEM);
+    }
+    rb_install(d, ctrl, ring_size, bytes);
+    d->ring_node = NUMA_NO_NODE;
+    mutex_init(&d->ring_lock);
+    mutex_init(&d->cfg_lock);
+
+    init_waitqueue_head(&d->wq);
+    init_waitqueue_head(&d->ev_wq);
+    spin_lock_init(&d->ev_lock);
+    spin_lock_init(&d->win_lock);
+    atomic64_set(&d->total_samples, 0);
+    atomic64_set(&d->threshold_crossings, 0);
+    atomic64_set(&d->ring_overwrites, 0);
+    atomic64_set(&d->reader_overruns, 0);
+    atomic64_set(&d->wakeups, 0);
+    atomic64_set(&d->suppressed, 0);
+    atomic64_set(&d->timer_overruns, 0);
+    atomic_set(&d->high_water, 0);
     
     /* initialize configurable parameters */
-    gdev->period_ms = SIMTEMP_PERIOD_MS;
-    gdev->threshold_mC = 45000;  /* 45°C default threshold */
-    gdev->mode = 2;               /* ramp mode by default */
-    gdev->above_threshold = false; /* start below threshold */
+    seqlock_init(&d->cfg_seq);
+    d->cfg.period_us = SIMTEMP_PERIOD_MS * 1000;
+    d->cfg.burst = 1;
+    d->cfg.threshold_mC = 45000;  /* 45°C default threshold */
+    d->cfg.mode = SIMTEMP_MODE_RAMP; /* ramp mode by default */
+    d->cfg.wakeup_watermark = 1;  /* wake on every publish */
+    d->cfg.wakeup_latency_us = 0;
+    d->cfg.window_us = 1000000;   /* 1 s summaries */
+    d->cfg.wave_amplitude_mC = 10000;  /* table waveforms: 25 +/- 10 °C... */
+    d->cfg.wave_period_us = 1000000;   /* ...once per second */
+    d->period = us_to_ktime(d->cfg.period_us);
+    d->producer = SIMTEMP_PRODUCER_WORK;
+    d->batch_min = 1;          /* return as soon as anything is queued */
+    d->batch_timeout_ms = 0;
+    d->above_threshold = false; /* start below threshold */
+    d->ramp_mC = 20000;        /* 20.000 °C */
+    d->prng = get_random_u32() | 1;
 
-    INIT_WORK(&gdev->work, simtemp_work_fn);
+    INIT_WORK(&d->work, simtemp_work_fn);
+    INIT_WORK(&d->log_work, simtemp_log_work_fn);
 
-    ret = misc_register(&simtemp_miscdev);
+    /* timer @ SIMTEMP_PERIOD_MS; set up before sysfs can restart it */
+    hrtimer_init(&d->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_PINNED);
+    d->timer.function = simtemp_timer_fn;
+    hrtimer_init(&d->flush_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    d->flush_timer.function = simtemp_flush_timer_fn;
+
+    /* instance 0 keeps the historical /dev/simtemp name */
+    if (id)
+        snprintf(d->name, sizeof(d->name), "simtemp%u", id);
+    else
+        strscpy(d->name, "simtemp", sizeof(d->name));
+
+    d->misc.minor  = MISC_DYNAMIC_MINOR;
+    d->misc.name   = d->name;
+    d->misc.fops   = &simtemp_fops;
+    d->misc.mode   = 0666;
+    d->misc.groups = simtemp_groups;   /* sysfs attributes */
+
+    ret = misc_register(&d->misc);
     if (ret) {
-        pr_err("simtemp: misc_register failed: %d\n", ret);
-        kfree(gdev);
-        return ret;
+        pr_err("simtemp: misc_register(%s) failed: %d\n", d->name, ret);
+        kvfree(d->stage);
+        free_percpu(d->hist);
+        vfree(d->ctrl);
+        kfree(d);
+        return ERR_PTR(ret);
     }
+    simtemp_debugfs_init(d);
 
-    /* create sysfs attributes */
-    ret = device_create_file(simtemp_miscdev.this_device, &dev_attr_sampling_ms);
-    if (ret) goto err_sysfs;
-    
-    ret = device_create_file(simtemp_miscdev.this_device, &dev_attr_threshold_mC);
-    if (ret) goto err_sysfs;
-    
-    ret = device_create_file(simtemp_miscdev.this_device, &dev_attr_mode);
-    if (ret) goto err_sysfs;
-    
-    ret = device_create_file(simtemp_miscdev.this_device, &dev_attr_stats);
-    if (ret) goto err_sysfs;
+    simtemp_producer_start(d);
 
-    /* timer @ SIMTEMP_PERIOD_MS */
-    gdev->period = ktime_set(0, SIMTEMP_PERIOD_MS * 1000000ULL);
-    hrtimer_init(&gdev->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_PINNED);
-    gdev->timer.function = simtemp_timer_fn;
-    hrtimer_start(&gdev->timer, gdev->period, HRTIMER_MODE_REL_PINNED);
+    pr_notice("simtemp: /dev/%s up, period=%d ms, ring=%u\n",
+              d->name, SIMTEMP_PERIOD_MS, d->size);
+    return d;
+}
 
-    pr_notice("simtemp: /dev/%s up, period=%d ms, ring=%d\n",
-              simtemp_miscdev.name, SIMTEMP_PERIOD_MS, RING_SIZE);
-    return 0;
+/* ---- Module init/exit ---- */
+static int __init simtemp_init(void)
+{
+    unsigned int i;
 
-err_sysfs:
-    pr_err("simtemp: failed to create sysfs attributes: %d\n", ret);
-    misc_deregister(&simtemp_miscdev);
-    kfree(gdev);
-    return ret;
+    if (!rb_size_valid(ring_size)) {
+        pr_err("simtemp: ring_size=%u must be a power of two in [%u, %u]\n",
+               ring_size, RING_SIZE_MIN, RING_SIZE_MAX);
+        return -EINVAL;
+    }
+    if (num_devices < 1 || num_devices > SIMTEMP_MAX_DEVICES) {
+        pr_err("simtemp: num_devices=%u must be in [1, %u]\n",
+               num_devices, SIMTEMP_MAX_DEVICES);
+        return -EINVAL;
+    }
+
+    simtemp_wave_init();
+    simtemp_wq = alloc_workqueue("simtemp", WQ_HIGHPRI, 0);
+    if (!simtemp_wq)
+        return -ENOMEM;
+    simtemp_debugfs_root = debugfs_create_dir("simtemp", NULL);
+
+    /* every sensor is fully independent: own ring, timer, sysfs and state */
+    for (i = 0; i < num_devices; i++) {
+        struct simtemp_dev *d = simtemp_create(i);
+
+        if (IS_ERR(d)) {
+            while (i--)
+                simtemp_destroy(simtemp_devs[i]);
+            debugfs_remove_recursive(simtemp_debugfs_root);
+            destroy_workqueue(simtemp_wq);
+            return PTR_ERR(d);
+        }
+        simtemp_devs[i] = d;
+    }
+    return 0;
 }
 
 static void __exit simtemp_exit(void)
 {
-    /* stop producer first */
-    hrtimer_cancel(&gdev->timer);
-    flush_work(&gdev->work);
-
-    /* remove sysfs attributes */
-    device_remove_file(simtemp_miscdev.this_device, &dev_attr_sampling_ms);
-    device_remove_file(simtemp_miscdev.this_device, &dev_attr_threshold_mC);
-    device_remove_file(simtemp_miscdev.this_device, &dev_attr_mode);
-    device_remove_file(simtemp_miscdev.this_device, &dev_attr_stats);
-
-    misc_deregister(&simtemp_miscdev);
+    unsigned int i;
 
-    kfree(gdev);
-    pr_notice("simtemp: /dev/%s down\n", simtemp_miscdev.name);
+    for (i = num_devices; i--; )
+        simtemp_destroy(simtemp_devs[i]);
+    debugfs_remove_recursive(simtemp_debugfs_root);
+    destroy_workqueue(simtemp_wq);
 }
 
 module_init(simtemp_init);
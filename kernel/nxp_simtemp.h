@@ -1,8 +1,239 @@
+/*
+ * nxp_simtemp.h - user-space ABI of /dev/simtemp*
+ *
+ * The one definition of every record, ioctl and mmap structure: the
+ * driver, the GUI and the tests all include this file. Builds without
+ * kernel sources; only the UAPI <linux/types.h> and <linux/ioctl.h>.
+ */
 #pragma once
 #include <linux/types.h>
+#include <linux/ioctl.h>
 
 struct simtemp_sample {
     __u64 timestamp_ns;  // monotonic timestamp
     __s32 temp_mC;       // e.g., 44123 = 44.123 °C
-    __u32 flags;         // bit0=NEW_SAMPLE, bit1=THRESHOLD_CROSSED
+    __u32 flags;         // bit0=NEW_SAMPLE, bit1=THRESHOLD_CROSSED, bit2=OVERRUN
 } __attribute__((packed));
+
+#define SIMTEMP_FLAG_NEW_SAMPLE  (1u << 0)
+#define SIMTEMP_FLAG_THRESHOLD   (1u << 1)
+#define SIMTEMP_FLAG_OVERRUN     (1u << 2)  // read(): records were lost just before this one
+
+/*
+ * read() record formats, chosen per file with SIMTEMP_IOC_SET_FORMAT. A
+ * driver that does not know the requested format fails with -EINVAL and
+ * the file keeps its current one, so consumers can try the newest format
+ * first and fall back. mmap() always exposes SIMTEMP_FORMAT_V1 slots.
+ *
+ * SIMTEMP_FORMAT_V1: struct simtemp_sample, 16 bytes (default).
+ *
+ * SIMTEMP_FORMAT_V2: struct simtemp_sample_v2, 24 bytes. seq is the ring
+ * sequence of the sample: consecutive records differ by exactly 1 unless
+ * samples were lost (modulo 2^32).
+ *
+ * SIMTEMP_FORMAT_COMPACT: a read() returns one or more batches, each a
+ * struct simtemp_compact_hdr followed by hdr.count struct simtemp_compact
+ * entries. Entry i is sequence hdr.seq + i, taken at hdr.base_ns +
+ * delta_ns. 8 bytes per sample plus 16 per batch; a new batch starts with
+ * every read() chunk, after a loss and when the delta would not fit.
+ */
+#define SIMTEMP_FORMAT_V1        0
+#define SIMTEMP_FORMAT_V2        1
+#define SIMTEMP_FORMAT_COMPACT   2
+
+struct simtemp_sample_v2 {
+    __u64 timestamp_ns;
+    __u32 seq;           // ring sequence, +1 per sample
+    __s32 temp_mC;
+    __u32 flags;         // SIMTEMP_FLAG_*
+    __u32 reserved;      // zero
+} __attribute__((packed));
+
+struct simtemp_compact_hdr {
+    __u64 base_ns;       // timestamp of the first entry
+    __u32 seq;           // sequence of the first entry
+    __u16 count;         // entries following this header
+    __u16 flags;         // SIMTEMP_COMPACT_*
+} __attribute__((packed));
+
+#define SIMTEMP_COMPACT_OVERRUN  (1u << 0)  // samples were lost just before this batch
+
+struct simtemp_compact {
+    __u32 delta_ns;      // timestamp - hdr.base_ns
+    __s32 value;         // temp_mC << 2 | SIMTEMP_FLAG_NEW_SAMPLE/THRESHOLD
+} __attribute__((packed));
+
+#define SIMTEMP_COMPACT_VALUE(mC, flags) ((__s32)(((__u32)(mC) << 2) | ((flags) & 3u)))
+#define SIMTEMP_COMPACT_TEMP(v)          ((__s32)(v) >> 2)  // arithmetic shift
+#define SIMTEMP_COMPACT_FLAGS(v)         ((__u32)(v) & 3u)
+
+/*
+ * mmap() layout of /dev/simtemp (read-only, offset 0):
+ *
+ *   [ struct simtemp_ring_ctrl | pad to page ][ capacity x struct simtemp_sample ]
+ *   ^ offset 0                                 ^ ctrl->data_offset
+ *
+ * head and tail are free-running u32 sequence numbers; the record for
+ * sequence s lives at slot (s & (capacity - 1)). Differences are taken
+ * modulo 2^32, so wrap-around is harmless.
+ *
+ * Consumer protocol (no syscalls on the data path):
+ *   1. h = __atomic_load_n(&ctrl->head, __ATOMIC_ACQUIRE);
+ *   2. valid records are [h - capacity + 1, h); clamp the local cursor to it
+ *   3. copy the records out of the data area
+ *   4. acquire fence, then load reserve; any copied sequence s with
+ *      (u32)(reserve - s) >= capacity may have been overwritten: drop it
+ *   5. when cursor == head, poll() for POLLIN and start over
+ *
+ * reserve runs ahead of head while the producer writes a burst: it is
+ * stored before the first slot is overwritten and head catches up with a
+ * single release store once the whole burst is in place.
+ *
+ * tail is the oldest sequence still held in the ring. Every open file has
+ * its own read() cursor, so mmap users and read() users never consume
+ * records for each other.
+ */
+#define SIMTEMP_RING_MAGIC    0x53544d52u  /* "STMR" */
+#define SIMTEMP_RING_VERSION  2
+
+struct simtemp_ring_ctrl {
+    __u32 magic;         // SIMTEMP_RING_MAGIC
+    __u32 version;       // SIMTEMP_RING_VERSION
+    __u32 capacity;      // records in the data area (power of two)
+    __u32 record_size;   // sizeof(struct simtemp_sample)
+    __u32 data_offset;   // byte offset of slot 0 from the start of the mapping
+    __u32 head;          // sequence of the next record to be written (release)
+    __u32 tail;          // oldest sequence still held in the ring
+    __u32 reserve;       // producer may be writing sequences below this one
+};
+
+/*
+ * Threshold crossing events, kept in a small queue next to the sample
+ * stream. poll() reports POLLPRI while the file has events pending and
+ * SIMTEMP_IOC_GET_EVENT pops the oldest one (blocks unless O_NONBLOCK,
+ * then -EAGAIN). Every open file has its own event cursor; a reader that
+ * falls more than SIMTEMP_EVENT_QUEUE events behind loses the oldest ones
+ * and gets SIMTEMP_EVENT_OVERRUN on the next event.
+ */
+#define SIMTEMP_EVENT_QUEUE      64
+
+struct simtemp_event {
+    __u64 timestamp_ns;  // timestamp of the crossing sample
+    __u32 seq;           // ring sequence of the crossing sample
+    __s32 temp_mC;       // temperature of the crossing sample
+    __s32 threshold_mC;  // threshold in force at the time
+    __u32 flags;         // SIMTEMP_EVENT_*
+} __attribute__((packed));
+
+#define SIMTEMP_EVENT_RISING     (1u << 0)  // crossed upwards (clear: downwards)
+#define SIMTEMP_EVENT_OVERRUN    (1u << 1)  // older events were dropped before this one
+
+/*
+ * Windowed aggregation: the producer folds samples into fixed windows of
+ * window_us (aligned to multiples of it on the sample clock) and queues
+ * one summary per window. A file switched to SIMTEMP_STREAM_WINDOW reads
+ * these instead of raw samples: read() returns whole struct
+ * simtemp_window records and poll() reports POLLIN when one is queued.
+ * Like events, a reader that falls more than SIMTEMP_WINDOW_QUEUE
+ * windows behind loses the oldest ones (SIMTEMP_WINDOW_OVERRUN).
+ */
+#define SIMTEMP_WINDOW_QUEUE     256
+
+struct simtemp_window {
+    __u64 start_ns;      // window covers [start_ns, end_ns) of sample time
+    __u64 end_ns;
+    __s32 min_mC;
+    __s32 max_mC;
+    __s32 mean_mC;       // rounded towards zero
+    __u32 count;         // samples in the window
+    __u32 crossings;     // samples with SIMTEMP_FLAG_THRESHOLD
+    __u32 flags;         // SIMTEMP_WINDOW_*
+} __attribute__((packed));
+
+#define SIMTEMP_WINDOW_OVERRUN   (1u << 0)  // older windows were dropped before this one
+
+#define SIMTEMP_STREAM_RAW       0  // simtemp_sample records (default)
+#define SIMTEMP_STREAM_WINDOW    1  // simtemp_window summaries
+
+#define SIMTEMP_MODE_NORMAL      0  // constant 25 °C
+#define SIMTEMP_MODE_NOISY       1  // 20..30 °C random
+#define SIMTEMP_MODE_RAMP        2  // 20..45 °C sawtooth
+/*
+ * Table waveforms around 25 °C: wave_amplitude_mC peak, one cycle per
+ * wave_period_us of sample time. Cost per sample is one table lookup.
+ */
+#define SIMTEMP_MODE_SINE        3
+#define SIMTEMP_MODE_STEP        4  // square wave: +amplitude, then -amplitude
+#define SIMTEMP_MODE_SAW         5  // -amplitude .. +amplitude, then drop
+/*
+ * Replay a recorded trace in a loop, one value per sample. The trace is an
+ * array of native-endian __s32 mC values loaded with request_firmware():
+ * `echo trace.bin > replay_firmware` (from /lib/firmware). 25 °C when none
+ * is loaded.
+ */
+#define SIMTEMP_MODE_REPLAY      6
+
+/*
+ * Whole device configuration, read and replaced in one ioctl. SET either
+ * applies every field or, on -EINVAL, none of them; the producer never
+ * sees a mix of old and new values. The period only restarts the timer
+ * when it actually changes. Mirrors the sysfs attributes of the same name.
+ */
+struct simtemp_config {
+    __u32 period_us;          // sampling_us: 20 .. 10000000
+    __s32 threshold_mC;       // threshold_mC: -50000 .. 150000
+    __u32 mode;               // SIMTEMP_MODE_*
+    __u32 burst;              // samples per timer expiry: 1 .. min(4096, capacity)
+    __u32 wakeup_watermark;   // 1 .. capacity
+    __u32 wakeup_latency_us;  // 0 .. 10000000 (0 = no bound)
+    __u32 window_us;          // 0 (off) or 1000 .. 60000000
+    __u32 wave_amplitude_mC;  // sine/step/saw: 0 .. 50000
+    __u32 wave_period_us;     // sine/step/saw: 1000 .. 60000000
+    __u32 timer_slack_us;     // 0 (precise) .. 10000000, capped at period_us
+    __u32 deadband_mC;        // 0 (off) .. 100000: publish only changes this large...
+    __u32 heartbeat_us;       // ...or after this much silence (0 = never), 0 .. 60000000
+    __u32 reserved[2];        // must be zero
+};
+
+/* Binary equivalent of the stats attribute */
+struct simtemp_stats {
+    __u64 total_samples;
+    __u64 threshold_crossings;
+    __u64 ring_overwrites;
+    __u64 reader_overruns;
+    __u64 wakeups;
+    __u64 suppressed;         // samples the deadband kept out of the ring
+};
+
+/*
+ * Performance counters (SIMTEMP_IOC_GET_PERF): the device's, plus those of
+ * the file the ioctl is issued on. Every count is monotonic since load or
+ * open; take two snapshots and divide by the timestamp_ns difference for
+ * rates. The per-file part only sees read(): an mmap consumer counts what
+ * it takes itself (libsimtemp's Device::getPerf() fills it in).
+ */
+struct simtemp_perf {
+    __u64 timestamp_ns;       // CLOCK_MONOTONIC of the snapshot
+    /* device */
+    __u64 total_samples;      // as in simtemp_stats
+    __u64 ring_overwrites;
+    __u64 wakeups;
+    __u64 timer_overruns;     // sampling periods missed altogether (timer or work backlog)
+    __u32 ring_high_water;    // deepest backlog any read() found, in records
+    __u32 readers;            // files open on the device
+    /* this file */
+    __u64 delivered;          // records read() handed out
+    __u64 bytes;              // bytes read() handed out, in the file's format
+    __u64 drops;              // records lost because this file lagged
+    __u64 reads;              // read() calls that returned data: mean batch = delivered / reads
+    __u64 reserved[2];        // zero
+};
+
+#define SIMTEMP_IOC_MAGIC        'S'
+#define SIMTEMP_IOC_GET_EVENT    _IOR(SIMTEMP_IOC_MAGIC, 1, struct simtemp_event)
+#define SIMTEMP_IOC_GET_CONFIG   _IOR(SIMTEMP_IOC_MAGIC, 2, struct simtemp_config)
+#define SIMTEMP_IOC_SET_CONFIG   _IOW(SIMTEMP_IOC_MAGIC, 3, struct simtemp_config)  // CAP_SYS_ADMIN
+#define SIMTEMP_IOC_GET_STATS    _IOR(SIMTEMP_IOC_MAGIC, 4, struct simtemp_stats)
+#define SIMTEMP_IOC_SET_STREAM   _IOW(SIMTEMP_IOC_MAGIC, 5, __u32)  // SIMTEMP_STREAM_*, per file
+#define SIMTEMP_IOC_SET_FORMAT   _IOW(SIMTEMP_IOC_MAGIC, 6, __u32)  // SIMTEMP_FORMAT_*, per file
+#define SIMTEMP_IOC_GET_PERF     _IOR(SIMTEMP_IOC_MAGIC, 7, struct simtemp_perf)
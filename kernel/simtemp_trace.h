@@ -0,0 +1,173 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * simtemp_trace.h - tracepoints of nxp_simtemp
+ *
+ * Enable with e.g. `echo 1 > /sys/kernel/tracing/events/simtemp/enable`
+ * or `perf record -e 'simtemp:*'`. Every event carries the instance name,
+ * so several sensors can be told apart in one trace.
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM simtemp
+
+#if !defined(_SIMTEMP_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _SIMTEMP_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/* instance names are short fixed-size strings (see struct simtemp_dev) */
+#define SIMTEMP_TRACE_NAME_LEN 16
+
+TRACE_EVENT(simtemp_sample,
+    TP_PROTO(const char *name, u32 seq, u64 timestamp_ns, s32 temp_mC, u32 flags),
+    TP_ARGS(name, seq, timestamp_ns, temp_mC, flags),
+
+    TP_STRUCT__entry(
+        __array(char, name, SIMTEMP_TRACE_NAME_LEN)
+        __field(u32, seq)
+        __field(u64, timestamp_ns)
+        __field(s32, temp_mC)
+        __field(u32, flags)
+    ),
+
+    TP_fast_assign(
+        strscpy(__entry->name, name, SIMTEMP_TRACE_NAME_LEN);
+        __entry->seq          = seq;
+        __entry->timestamp_ns = timestamp_ns;
+        __entry->temp_mC      = temp_mC;
+        __entry->flags        = flags;
+    ),
+
+    TP_printk("%s seq=%u ts=%llu temp=%d mC flags=0x%x",
+              __entry->name, __entry->seq, __entry->timestamp_ns,
+              __entry->temp_mC, __entry->flags)
+);
+
+TRACE_EVENT(simtemp_threshold,
+    TP_PROTO(const char *name, u32 seq, s32 temp_mC, s32 threshold_mC, bool up),
+    TP_ARGS(name, seq, temp_mC, threshold_mC, up),
+
+    TP_STRUCT__entry(
+        __array(char, name, SIMTEMP_TRACE_NAME_LEN)
+        __field(u32, seq)
+        __field(s32, temp_mC)
+        __field(s32, threshold_mC)
+        __field(bool, up)
+    ),
+
+    TP_fast_assign(
+        strscpy(__entry->name, name, SIMTEMP_TRACE_NAME_LEN);
+        __entry->seq          = seq;
+        __entry->temp_mC      = temp_mC;
+        __entry->threshold_mC = threshold_mC;
+        __entry->up           = up;
+    ),
+
+    TP_printk("%s seq=%u %s temp=%d mC threshold=%d mC",
+              __entry->name, __entry->seq, __entry->up ? "UP" : "DOWN",
+              __entry->temp_mC, __entry->threshold_mC)
+);
+
+TRACE_EVENT(simtemp_ring_overwrite,
+    TP_PROTO(const char *name, u32 tail, u32 dropped),
+    TP_ARGS(name, tail, dropped),
+
+    TP_STRUCT__entry(
+        __array(char, name, SIMTEMP_TRACE_NAME_LEN)
+        __field(u32, tail)
+        __field(u32, dropped)
+    ),
+
+    TP_fast_assign(
+        strscpy(__entry->name, name, SIMTEMP_TRACE_NAME_LEN);
+        __entry->tail    = tail;
+        __entry->dropped = dropped;
+    ),
+
+    TP_printk("%s tail=%u dropped=%u",
+              __entry->name, __entry->tail, __entry->dropped)
+);
+
+TRACE_EVENT(simtemp_reader_wake,
+    TP_PROTO(const char *name, u32 head, u32 pending),
+    TP_ARGS(name, head, pending),
+
+    TP_STRUCT__entry(
+        __array(char, name, SIMTEMP_TRACE_NAME_LEN)
+        __field(u32, head)
+        __field(u32, pending)
+    ),
+
+    TP_fast_assign(
+        strscpy(__entry->name, name, SIMTEMP_TRACE_NAME_LEN);
+        __entry->head    = head;
+        __entry->pending = pending;
+    ),
+
+    TP_printk("%s head=%u pending=%u",
+              __entry->name, __entry->head, __entry->pending)
+);
+
+TRACE_EVENT(simtemp_read,
+    TP_PROTO(const char *name, u32 cursor, u32 records, u32 lost),
+    TP_ARGS(name, cursor, records, lost),
+
+    TP_STRUCT__entry(
+        __array(char, name, SIMTEMP_TRACE_NAME_LEN)
+        __field(u32, cursor)
+        __field(u32, records)
+        __field(u32, lost)
+    ),
+
+    TP_fast_assign(
+        strscpy(__entry->name, name, SIMTEMP_TRACE_NAME_LEN);
+        __entry->cursor  = cursor;
+        __entry->records = records;
+        __entry->lost    = lost;
+    ),
+
+    TP_printk("%s cursor=%u records=%u lost=%u",
+              __entry->name, __entry->cursor, __entry->records, __entry->lost)
+);
+
+TRACE_EVENT(simtemp_config,
+    TP_PROTO(const char *name, u32 period_us, s32 threshold_mC, u32 mode,
+             u32 burst, u32 wakeup_watermark, u32 wakeup_latency_us, u32 window_us),
+    TP_ARGS(name, period_us, threshold_mC, mode, burst, wakeup_watermark,
+            wakeup_latency_us, window_us),
+
+    TP_STRUCT__entry(
+        __array(char, name, SIMTEMP_TRACE_NAME_LEN)
+        __field(u32, period_us)
+        __field(s32, threshold_mC)
+        __field(u32, mode)
+        __field(u32, burst)
+        __field(u32, wakeup_watermark)
+        __field(u32, wakeup_latency_us)
+        __field(u32, window_us)
+    ),
+
+    TP_fast_assign(
+        strscpy(__entry->name, name, SIMTEMP_TRACE_NAME_LEN);
+        __entry->period_us         = period_us;
+        __entry->threshold_mC      = threshold_mC;
+        __entry->mode              = mode;
+        __entry->burst             = burst;
+        __entry->wakeup_watermark  = wakeup_watermark;
+        __entry->wakeup_latency_us = wakeup_latency_us;
+        __entry->window_us         = window_us;
+    ),
+
+    TP_printk("%s period=%u us threshold=%d mC mode=%u burst=%u watermark=%u latency=%u us window=%u us",
+              __entry->name, __entry->period_us, __entry->threshold_mC,
+              __entry->mode, __entry->burst, __entry->wakeup_watermark,
+              __entry->wakeup_latency_us, __entry->window_us)
+);
+
+#endif /* _SIMTEMP_TRACE_H */
+
+/* this part must be outside the include guard */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE simtemp_trace
+#include <trace/define_trace.h>
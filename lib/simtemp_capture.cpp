@@ -0,0 +1,381 @@
+// simtemp_capture.cpp - .stcap writer and mapped reader (see simtemp_capture.h)
+
+#include "simtemp_capture.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace simtemp {
+namespace capture {
+
+namespace {
+
+size_t pad8(size_t n) {
+    return (n + 7) & ~size_t(7);
+}
+
+int writeAll(int fd, struct iovec* iov, int cnt) {
+    while (cnt > 0) {
+        ssize_t n = ::writev(fd, iov, cnt);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        while (cnt > 0 && size_t(n) >= iov->iov_len) {
+            n -= ssize_t(iov->iov_len);
+            ++iov;
+            --cnt;
+        }
+        if (cnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+            iov->iov_len -= size_t(n);
+        }
+    }
+    return 0;
+}
+
+uint64_t zigzag(int64_t v) {
+    return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+}
+
+int64_t unzigzag(uint64_t v) {
+    return int64_t(v >> 1) ^ -int64_t(v & 1);
+}
+
+void putVarint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(uint8_t(v) | 0x80);
+        v >>= 7;
+    }
+    out.push_back(uint8_t(v));
+}
+
+bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t* v) {
+    uint64_t r = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        const uint8_t b = *p++;
+        r |= uint64_t(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = r;
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+/* ---- Writer ---- */
+
+Writer::~Writer() {
+    close();
+}
+
+int Writer::open(const std::string& path, const std::string& device, uint32_t chunk_samples,
+                 Codec codec) {
+    if (fd_ >= 0 || chunk_samples == 0)
+        return -EINVAL;
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+        return -errno;
+
+    codec_ = codec;
+    chunkSamples_ = chunk_samples;
+    samples_ = 0;
+    hdr_ = ChunkHeader{};
+    index_.clear();
+    delta_.reserve(chunk_samples);
+    temp_.reserve(chunk_samples);
+    flags_.reserve(chunk_samples);
+
+    FileHeader fh{};
+    std::memcpy(fh.magic, kFileMagic, sizeof(fh.magic));
+    fh.version = kVersion;
+    fh.chunk_samples = chunk_samples;
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    fh.created_ns = uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+    std::strncpy(fh.device, device.c_str(), sizeof(fh.device) - 1);
+
+    struct iovec iov { &fh, sizeof(fh) };
+    int ret = writeAll(fd_, &iov, 1);
+    if (ret) {
+        ::close(fd_);
+        fd_ = -1;
+        return ret;
+    }
+    bytes_ = sizeof(fh);
+    return 0;
+}
+
+int Writer::append(const simtemp_sample* s, size_t n) {
+    if (fd_ < 0)
+        return -EBADF;
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t ts = s[i].timestamp_ns;
+        // a delta that does not fit (or time going back) starts a new chunk
+        if (hdr_.count && (ts < prevNs_ || ts - prevNs_ > UINT32_MAX)) {
+            if (int ret = flushChunk())
+                return ret;
+        }
+        if (hdr_.count == 0) {
+            hdr_.first_ns = ts;
+            hdr_.min_mC = hdr_.max_mC = s[i].temp_mC;
+            prevNs_ = ts;
+        }
+        delta_.push_back(uint32_t(ts - prevNs_));
+        temp_.push_back(s[i].temp_mC);
+        flags_.push_back(uint8_t(s[i].flags));
+        hdr_.last_ns = prevNs_ = ts;
+        hdr_.min_mC = std::min(hdr_.min_mC, s[i].temp_mC);
+        hdr_.max_mC = std::max(hdr_.max_mC, s[i].temp_mC);
+        hdr_.flags_any |= s[i].flags;
+        ++samples_;
+        if (++hdr_.count == chunkSamples_) {
+            if (int ret = flushChunk())
+                return ret;
+        }
+    }
+    return 0;
+}
+
+void Writer::encodeRaw(std::vector<uint8_t>& out) const {
+    const size_t n = hdr_.count;
+    out.resize(pad8(n * 4 + n * 4 + n));
+    uint8_t* p = out.data();
+    std::memcpy(p, delta_.data(), n * 4);
+    std::memcpy(p + n * 4, temp_.data(), n * 4);
+    std::memcpy(p + n * 8, flags_.data(), n);
+    std::memset(p + n * 9, 0, out.size() - n * 9);
+}
+
+void Writer::encodePacked(std::vector<uint8_t>& out) const {
+    out.clear();
+    int64_t prev = 0;
+    for (uint32_t d : delta_) {
+        putVarint(out, zigzag(int64_t(d) - prev));  // steady period -> 0 -> one byte
+        prev = d;
+    }
+    prev = 0;
+    for (int32_t t : temp_) {
+        putVarint(out, zigzag(int64_t(t) - prev));
+        prev = t;
+    }
+    out.insert(out.end(), flags_.begin(), flags_.end());
+    out.resize(pad8(out.size()), 0);
+}
+
+int Writer::flushChunk() {
+    if (hdr_.count == 0)
+        return 0;
+    if (codec_ == CODEC_PACKED)
+        encodePacked(payload_);
+    else
+        encodeRaw(payload_);
+
+    hdr_.magic = kChunkMagic;
+    hdr_.codec = codec_;
+    hdr_.payload_bytes = uint32_t(payload_.size());
+
+    struct iovec iov[2] = { { &hdr_, sizeof(hdr_) }, { payload_.data(), payload_.size() } };
+    int ret = writeAll(fd_, iov, 2);
+    if (ret)
+        return ret;
+    // indexed only once it is in the file, so a retry cannot list it twice
+    index_.push_back({ bytes_, hdr_.first_ns, hdr_.last_ns, hdr_.min_mC, hdr_.max_mC,
+                       hdr_.count, hdr_.flags_any });
+    bytes_ += sizeof(hdr_) + payload_.size();
+
+    hdr_ = ChunkHeader{};
+    delta_.clear();
+    temp_.clear();
+    flags_.clear();
+    return 0;
+}
+
+int Writer::close() {
+    if (fd_ < 0)
+        return 0;
+    int ret = flushChunk();
+    if (!ret) {
+        Trailer t{ bytes_, uint32_t(index_.size()), kIndexMagic };
+        struct iovec iov[2] = { { index_.data(), index_.size() * sizeof(IndexEntry) },
+                                { &t, sizeof(t) } };
+        ret = writeAll(fd_, iov, 2);
+        if (!ret)
+            bytes_ += iov[0].iov_len + sizeof(t);
+    }
+    if (::close(fd_) && !ret)
+        ret = -errno;
+    fd_ = -1;
+    return ret;
+}
+
+/* ---- Reader ---- */
+
+Reader::~Reader() {
+    close();
+}
+
+void Reader::close() {
+    if (base_)
+        ::munmap(const_cast<uint8_t*>(base_), len_);
+    base_ = nullptr;
+    len_ = 0;
+    hdr_ = nullptr;
+    index_.clear();
+    samples_ = 0;
+}
+
+int Reader::open(const std::string& path) {
+    close();
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+    struct stat st {};
+    if (::fstat(fd, &st) < 0) {
+        const int err = -errno;
+        ::close(fd);
+        return err;
+    }
+    if (size_t(st.st_size) < sizeof(FileHeader)) {
+        ::close(fd);
+        return -EINVAL;
+    }
+    void* p = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    const int err = p == MAP_FAILED ? -errno : 0;
+    ::close(fd);
+    if (err)
+        return err;
+
+    base_ = static_cast<const uint8_t*>(p);
+    len_ = size_t(st.st_size);
+    hdr_ = reinterpret_cast<const FileHeader*>(base_);
+    if (std::memcmp(hdr_->magic, kFileMagic, sizeof(kFileMagic)) || hdr_->version != kVersion) {
+        close();
+        return -EINVAL;
+    }
+    ::madvise(p, len_, MADV_RANDOM);  // seeks pull in single chunks, not readahead
+
+    indexed_ = loadIndex();
+    if (!indexed_)
+        scanChunks();
+    for (const IndexEntry& e : index_)
+        samples_ += e.count;
+    return 0;
+}
+
+bool Reader::loadIndex() {
+    if (len_ < sizeof(FileHeader) + sizeof(Trailer))
+        return false;
+    const auto* t = reinterpret_cast<const Trailer*>(base_ + len_ - sizeof(Trailer));
+    if (t->magic != kIndexMagic || t->index_offset < sizeof(FileHeader) ||
+        t->index_offset + uint64_t(t->chunks) * sizeof(IndexEntry) != len_ - sizeof(Trailer))
+        return false;
+    const auto* e = reinterpret_cast<const IndexEntry*>(base_ + t->index_offset);
+    index_.assign(e, e + t->chunks);
+    for (const IndexEntry& ie : index_) {
+        if (ie.offset + sizeof(ChunkHeader) > t->index_offset) {
+            index_.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void Reader::scanChunks() {
+    index_.clear();
+    size_t off = sizeof(FileHeader);
+    while (off + sizeof(ChunkHeader) <= len_) {
+        const auto* h = reinterpret_cast<const ChunkHeader*>(base_ + off);
+        if (h->magic != kChunkMagic || h->count == 0 ||
+            off + sizeof(ChunkHeader) + h->payload_bytes > len_)
+            break;  // end of the recorded data, or a torn last chunk
+        index_.push_back({ off, h->first_ns, h->last_ns, h->min_mC, h->max_mC, h->count,
+                           h->flags_any });
+        off += sizeof(ChunkHeader) + h->payload_bytes;
+    }
+}
+
+size_t Reader::findChunk(uint64_t t_ns) const {
+    return size_t(std::partition_point(index_.begin(), index_.end(),
+                                       [&](const IndexEntry& e) { return e.last_ns < t_ns; }) -
+                  index_.begin());
+}
+
+const ChunkHeader* Reader::chunkHeader(size_t i) const {
+    const auto* h = reinterpret_cast<const ChunkHeader*>(base_ + index_[i].offset);
+    if (h->magic != kChunkMagic ||
+        index_[i].offset + sizeof(ChunkHeader) + h->payload_bytes > len_)
+        return nullptr;
+    return h;
+}
+
+bool Reader::rawColumns(size_t i, const uint32_t** delta, const int32_t** temp,
+                        const uint8_t** flags) const {
+    const ChunkHeader* h = chunkHeader(i);
+    if (!h || h->codec != CODEC_RAW || h->payload_bytes < size_t(h->count) * 9)
+        return false;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(h + 1);
+    *delta = reinterpret_cast<const uint32_t*>(p);
+    *temp = reinterpret_cast<const int32_t*>(p + size_t(h->count) * 4);
+    *flags = p + size_t(h->count) * 8;
+    return true;
+}
+
+int Reader::decode(size_t i, std::vector<simtemp_sample>& out) const {
+    const ChunkHeader* h = chunkHeader(i);
+    if (!h)
+        return -EINVAL;
+    const size_t n = h->count;
+    out.resize(n);
+
+    const uint32_t* delta;
+    const int32_t* temp;
+    const uint8_t* flags;
+    if (rawColumns(i, &delta, &temp, &flags)) {
+        uint64_t ts = h->first_ns;
+        for (size_t k = 0; k < n; ++k) {
+            ts += delta[k];
+            out[k] = { ts, temp[k], flags[k] };
+        }
+        return 0;
+    }
+    if (h->codec != CODEC_PACKED)
+        return -EINVAL;
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(h + 1);
+    const uint8_t* end = p + h->payload_bytes;
+    uint64_t v, ts = h->first_ns;
+    int64_t d = 0, t = 0;
+    for (size_t k = 0; k < n; ++k) {
+        if (!getVarint(p, end, &v))
+            return -EINVAL;
+        d += unzigzag(v);
+        ts += uint64_t(d);
+        out[k].timestamp_ns = ts;
+    }
+    for (size_t k = 0; k < n; ++k) {
+        if (!getVarint(p, end, &v))
+            return -EINVAL;
+        t += unzigzag(v);
+        out[k].temp_mC = int32_t(t);
+    }
+    if (size_t(end - p) < n)
+        return -EINVAL;
+    for (size_t k = 0; k < n; ++k)
+        out[k].flags = p[k];
+    return 0;
+}
+
+}  // namespace capture
+}  // namespace simtemp
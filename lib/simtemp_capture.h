@@ -0,0 +1,161 @@
+// simtemp_capture.h - chunked columnar capture files (.stcap), part of libsimtemp
+//
+// Layout (native endian, every part 8-byte aligned):
+//
+//   [ FileHeader ][ ChunkHeader | payload ]...[ IndexEntry x chunks ][ Trailer ]
+//
+// A chunk holds up to FileHeader::chunk_samples samples as three columns:
+// timestamp deltas (u32 ns from the previous sample, 0 for the first),
+// temperatures (s32 mC) and flags (u8). With CODEC_RAW the columns are
+// stored as plain arrays, so a mapped file is read in place; CODEC_PACKED
+// stores the timestamp delta-of-delta and the temperature delta as zigzag
+// varints (flags stay raw), typically 3-4 bytes per sample instead of 9.
+// Every chunk header carries its time range and min/max, and the index at
+// the end repeats them so a reader can seek without touching the data. A
+// capture that was cut short (no index) is recovered by walking the chunk
+// headers.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nxp_simtemp.h"
+
+namespace simtemp {
+namespace capture {
+
+constexpr char kFileMagic[8] = { 'S', 'I', 'M', 'T', 'C', 'A', 'P', '1' };
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kChunkMagic = 0x4b4e4843u;  // "CHNK"
+constexpr uint32_t kIndexMagic = 0x58444e49u;  // "INDX"
+
+enum Codec : uint16_t {
+    CODEC_RAW = 0,
+    CODEC_PACKED = 1,
+};
+
+struct FileHeader {
+    char magic[8];           // kFileMagic
+    uint32_t version;        // kVersion
+    uint32_t chunk_samples;  // upper bound of ChunkHeader::count
+    uint64_t created_ns;     // CLOCK_REALTIME when recording started
+    char device[16];         // e.g. "simtemp", NUL padded
+    uint8_t reserved[24];
+};
+static_assert(sizeof(FileHeader) == 64, "FileHeader layout");
+
+struct ChunkHeader {
+    uint32_t magic;          // kChunkMagic
+    uint16_t codec;          // Codec
+    uint16_t reserved0;
+    uint32_t count;          // samples in this chunk
+    uint32_t payload_bytes;  // bytes following this header, multiple of 8
+    uint64_t first_ns;       // timestamp of the first sample
+    uint64_t last_ns;        // timestamp of the last sample
+    int32_t min_mC;
+    int32_t max_mC;
+    uint32_t flags_any;      // OR of every sample's flags
+    uint32_t reserved1;
+};
+static_assert(sizeof(ChunkHeader) == 48, "ChunkHeader layout");
+
+struct IndexEntry {
+    uint64_t offset;         // file offset of the ChunkHeader
+    uint64_t first_ns;
+    uint64_t last_ns;
+    int32_t min_mC;
+    int32_t max_mC;
+    uint32_t count;
+    uint32_t flags_any;
+};
+static_assert(sizeof(IndexEntry) == 40, "IndexEntry layout");
+
+struct Trailer {
+    uint64_t index_offset;   // file offset of the first IndexEntry
+    uint32_t chunks;
+    uint32_t magic;          // kIndexMagic
+};
+static_assert(sizeof(Trailer) == 16, "Trailer layout");
+
+// Appends samples to a capture; like the rest of libsimtemp, -errno on failure.
+class Writer {
+public:
+    Writer() = default;
+    ~Writer();
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    int open(const std::string& path, const std::string& device = "simtemp",
+             uint32_t chunk_samples = 65536, Codec codec = CODEC_RAW);
+    int append(const simtemp_sample* s, size_t n);
+    // Flushes the open chunk and writes the index; the file is complete after it.
+    int close();
+
+    uint64_t samples() const { return samples_; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    int flushChunk();
+    void encodeRaw(std::vector<uint8_t>& out) const;
+    void encodePacked(std::vector<uint8_t>& out) const;
+
+    int fd_ = -1;
+    Codec codec_ = CODEC_RAW;
+    uint32_t chunkSamples_ = 0;
+    uint64_t samples_ = 0;
+    uint64_t bytes_ = 0;
+
+    // the chunk being filled
+    ChunkHeader hdr_{};
+    uint64_t prevNs_ = 0;
+    std::vector<uint32_t> delta_;
+    std::vector<int32_t> temp_;
+    std::vector<uint8_t> flags_;
+    std::vector<uint8_t> payload_;
+    std::vector<IndexEntry> index_;
+};
+
+// Maps a capture read-only; opening is O(chunks) at worst, O(1) with an index.
+class Reader {
+public:
+    Reader() = default;
+    ~Reader();
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    int open(const std::string& path);
+    void close();
+
+    const FileHeader& header() const { return *hdr_; }
+    // false when the index was rebuilt from the chunk headers
+    bool indexed() const { return indexed_; }
+    uint64_t samples() const { return samples_; }
+
+    size_t chunks() const { return index_.size(); }
+    const IndexEntry& chunk(size_t i) const { return index_[i]; }
+    // First chunk whose last sample is at or after @t_ns (chunks() if none).
+    size_t findChunk(uint64_t t_ns) const;
+
+    // Columns of a CODEC_RAW chunk, pointing into the mapping; false otherwise.
+    bool rawColumns(size_t i, const uint32_t** delta, const int32_t** temp,
+                    const uint8_t** flags) const;
+    // Any codec, as absolute records; -EINVAL if the chunk is corrupt.
+    int decode(size_t i, std::vector<simtemp_sample>& out) const;
+
+private:
+    const ChunkHeader* chunkHeader(size_t i) const;
+    bool loadIndex();
+    void scanChunks();
+
+    const uint8_t* base_ = nullptr;
+    size_t len_ = 0;
+    const FileHeader* hdr_ = nullptr;
+    bool indexed_ = false;
+    uint64_t samples_ = 0;
+    std::vector<IndexEntry> index_;
+};
+
+}  // namespace capture
+}  // namespace simtemp
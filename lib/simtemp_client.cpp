@@ -0,0 +1,444 @@
+// simtemp_client.cpp - libsimtemp implementation (see simtemp_client.h)
+
+#include "simtemp_client.h"
+#include "simtemp_sim.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace simtemp {
+
+namespace {
+
+// indexed by SIMTEMP_MODE_*, as printed by the mode attribute
+const char* const kModeNames[] = { "normal", "noisy", "ramp", "sine", "step", "saw", "replay" };
+
+// simtemp_config fields that have a sysfs attribute of the same meaning
+struct ConfigAttr {
+    const char* name;
+    __u32 simtemp_config::*field;
+};
+const ConfigAttr kConfigAttrs[] = {
+    { "sampling_us", &simtemp_config::period_us },
+    { "burst", &simtemp_config::burst },
+    { "wakeup_watermark", &simtemp_config::wakeup_watermark },
+    { "wakeup_latency_us", &simtemp_config::wakeup_latency_us },
+    { "window_us", &simtemp_config::window_us },
+    { "wave_amplitude_mC", &simtemp_config::wave_amplitude_mC },
+    { "wave_period_us", &simtemp_config::wave_period_us },
+    { "timer_slack_us", &simtemp_config::timer_slack_us },
+    { "deadband_mC", &simtemp_config::deadband_mC },
+    { "heartbeat_us", &simtemp_config::heartbeat_us },
+};
+
+// how long a read(..., -1) on a SimSensor keeps running the virtual clock
+constexpr uint64_t kSimWaitForeverNs = 60ull * 1000000000ull;
+
+int64_t nowMs() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+}  // namespace
+
+std::string devicePath(const std::string& name) {
+    return "/dev/" + name;
+}
+
+std::string sysfsPath(const std::string& name) {
+    return "/sys/class/misc/" + name;
+}
+
+/* ---- Sysfs ---- */
+
+Sysfs::Sysfs(const std::string& name) : base_(sysfsPath(name)) {}
+
+Sysfs::~Sysfs() {
+    close();
+}
+
+bool Sysfs::present() const {
+    struct stat st {};
+    return ::stat(base_.c_str(), &st) == 0;
+}
+
+void Sysfs::close() {
+    for (auto& kv : fds_) {
+        if (kv.second.rd >= 0) ::close(kv.second.rd);
+        if (kv.second.wr >= 0) ::close(kv.second.wr);
+    }
+    fds_.clear();
+}
+
+Sysfs::Fds& Sysfs::fds(const std::string& attr) {
+    return fds_[attr];
+}
+
+int Sysfs::read(const std::string& attr, std::string* value) {
+    Fds& f = fds(attr);
+    if (f.rd < 0) {
+        f.rd = ::open((base_ + "/" + attr).c_str(), O_RDONLY | O_CLOEXEC);
+        if (f.rd < 0)
+            return -errno;
+    }
+
+    // attributes are at most a page; offset 0 makes sysfs call show() again
+    char buf[4096];
+    const ssize_t n = ::pread(f.rd, buf, sizeof(buf), 0);
+    if (n < 0)
+        return -errno;
+    size_t len = size_t(n);
+    while (len && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+        --len;
+    value->assign(buf, len);
+    return 0;
+}
+
+int Sysfs::write(const std::string& attr, const std::string& value) {
+    Fds& f = fds(attr);
+    if (f.wr < 0) {
+        f.wr = ::open((base_ + "/" + attr).c_str(), O_WRONLY | O_CLOEXEC);
+        if (f.wr < 0)
+            return -errno;
+    }
+
+    std::string payload = value;
+    if (!payload.empty() && payload.back() != '\n')
+        payload.push_back('\n');
+
+    // each write at offset 0 is one store() call
+    const ssize_t n = ::pwrite(f.wr, payload.data(), payload.size(), 0);
+    if (n < 0)
+        return -errno;
+    return size_t(n) == payload.size() ? 0 : -EIO;
+}
+
+int Sysfs::readInt(const std::string& attr, long long* value) {
+    std::string text;
+    int ret = read(attr, &text);
+    if (ret)
+        return ret;
+    char* end = nullptr;
+    errno = 0;
+    const long long v = std::strtoll(text.c_str(), &end, 0);
+    if (errno || end == text.c_str())
+        return -EINVAL;
+    *value = v;
+    return 0;
+}
+
+int Sysfs::writeInt(const std::string& attr, long long value) {
+    return write(attr, std::to_string(value));
+}
+
+int Sysfs::stats(Stats* out) {
+    std::string text;
+    int ret = read("stats", &text);
+    if (ret)
+        return ret;
+
+    *out = Stats{};
+    std::istringstream ss(text);
+    std::string line;
+    while (std::getline(ss, line)) {
+        const auto pos = line.find('=');
+        if (pos == std::string::npos)
+            continue;
+        const std::string key = line.substr(0, pos);
+        const __u64 value = std::strtoull(line.c_str() + pos + 1, nullptr, 10);
+        if (key == "total_samples") out->total_samples = value;
+        else if (key == "threshold_crossings") out->threshold_crossings = value;
+        else if (key == "ring_overwrites") out->ring_overwrites = value;
+        else if (key == "reader_overruns") out->reader_overruns = value;
+        else if (key == "wakeups") out->wakeups = value;
+        else if (key == "suppressed") out->suppressed = value;
+    }
+    return 0;
+}
+
+/* ---- Device ---- */
+
+Device::Device(const std::string& name, Transport transport)
+    : name_(name), sysfs_(name) {
+    // non-blocking: read() waits in poll() itself, so timeouts are exact
+    fd_ = ::open(devicePath(name).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ < 0)
+        throw std::system_error(errno, std::generic_category(), "open " + devicePath(name));
+    if (transport == Transport::Auto)
+        mapRing();
+}
+
+Device::Device(SimSensor& sim) : name_("sim"), sysfs_(name_), sim_(&sim) {
+    sim.openReader();
+    ctrl_ = sim.ctrl();
+    ring_ = sim.ring();
+    capacity_ = ctrl_->capacity;
+    cursor_ = ctrl_->head;
+    evCursor_ = sim.eventHead();
+}
+
+Device::~Device() {
+    if (sim_)
+        sim_->closeReader();
+    unmapRing();
+    if (fd_ >= 0)
+        ::close(fd_);
+}
+
+void Device::mapRing() {
+    const long page = ::sysconf(_SC_PAGESIZE);
+    void* hdr = ::mmap(nullptr, page, PROT_READ, MAP_SHARED, fd_, 0);
+    if (hdr == MAP_FAILED)
+        return;  // older driver: stay on read()
+    const auto* c = static_cast<const simtemp_ring_ctrl*>(hdr);
+    const bool ok = c->magic == SIMTEMP_RING_MAGIC && c->version == SIMTEMP_RING_VERSION &&
+                    c->record_size == sizeof(Sample) && c->capacity &&
+                    !(c->capacity & (c->capacity - 1));
+    const uint32_t capacity = c->capacity, offset = c->data_offset;
+    ::munmap(hdr, page);
+    if (!ok)
+        return;
+
+    const size_t len = size_t(offset) + size_t(capacity) * sizeof(Sample);
+    void* base = ::mmap(nullptr, len, PROT_READ, MAP_SHARED, fd_, 0);
+    if (base == MAP_FAILED)
+        return;
+    ctrl_ = static_cast<const simtemp_ring_ctrl*>(base);
+    ring_ = reinterpret_cast<const Sample*>(static_cast<const char*>(base) + offset);
+    mapLen_ = len;
+    capacity_ = capacity;
+    // like a fresh read() cursor: start with the next sample
+    cursor_ = __atomic_load_n(&ctrl_->head, __ATOMIC_ACQUIRE);
+}
+
+void Device::unmapRing() {
+    if (ctrl_ && !sim_)
+        ::munmap(const_cast<simtemp_ring_ctrl*>(ctrl_), mapLen_);
+    ctrl_ = nullptr;
+    ring_ = nullptr;
+}
+
+// Ring consumer protocol of kernel/nxp_simtemp.h: copy, then validate against reserve.
+ssize_t Device::readRing(Sample* out, size_t max) {
+    const uint32_t head = __atomic_load_n(&ctrl_->head, __ATOMIC_ACQUIRE);
+    maxBacklog_ = std::max(maxBacklog_, std::min(head - cursor_, capacity_ - 1));
+    if (head - cursor_ >= capacity_) {
+        lost_ += uint32_t(head - cursor_) - (capacity_ - 1);
+        cursor_ = head - capacity_ + 1;
+        gap_ = true;
+    }
+
+    const size_t n = std::min<size_t>(max, head - cursor_);
+    for (size_t i = 0; i < n; ++i)
+        out[i] = ring_[(cursor_ + i) & (capacity_ - 1)];
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    const uint32_t reserve = __atomic_load_n(&ctrl_->reserve, __ATOMIC_RELAXED);
+
+    // drop the copies the producer may have overwritten meanwhile
+    size_t skip = 0;
+    while (skip < n && uint32_t(reserve - (cursor_ + skip)) >= capacity_)
+        ++skip;
+    if (skip) {
+        std::memmove(out, out + skip, (n - skip) * sizeof(Sample));
+        lost_ += skip;
+        gap_ = true;
+    }
+    cursor_ += uint32_t(n);
+
+    const size_t kept = n - skip;
+    if (kept && gap_) {
+        out[0].flags |= SIMTEMP_FLAG_OVERRUN;
+        gap_ = false;
+    }
+    if (kept) {
+        delivered_ += kept;
+        ++reads_;
+    }
+    return ssize_t(kept);
+}
+
+int Device::waitReadable(int timeout_ms) {
+    struct pollfd pfd { fd_, POLLIN, 0 };
+    const int ret = ::poll(&pfd, 1, timeout_ms);
+    if (ret < 0)
+        return errno == EINTR ? 0 : -errno;
+    return ret;
+}
+
+ssize_t Device::read(Sample* out, size_t max, int timeout_ms) {
+    if (format_ != SIMTEMP_FORMAT_V1 || stream_ != SIMTEMP_STREAM_RAW)
+        return -EINVAL;
+    if (max == 0)
+        return 0;
+    const int64_t deadline = timeout_ms > 0 ? nowMs() + timeout_ms : 0;
+    const uint64_t simDeadline =
+        sim_ ? sim_->now() + (timeout_ms < 0 ? kSimWaitForeverNs : uint64_t(timeout_ms) * 1000000) : 0;
+
+    for (;;) {
+        ssize_t n;
+        if (sim_) {
+            // the driver's read() counts what its readers lose; do the same
+            const uint64_t before = lost_;
+            n = readRing(out, max);
+            sim_->addReaderOverruns(lost_ - before);
+            sim_->noteBacklog(maxBacklog_);
+        } else if (ctrl_) {
+            n = readRing(out, max);
+        } else {
+            n = ::read(fd_, out, max * sizeof(Sample));
+            if (n < 0 && errno != EAGAIN && errno != EINTR)
+                return -errno;
+            n = n < 0 ? 0 : n / ssize_t(sizeof(Sample));
+        }
+        if (n > 0 || timeout_ms == 0)
+            return n;
+
+        if (sim_) {
+            // "sleep" until the next expiry by jumping the clock there
+            if (sim_->nextExpiry() > simDeadline) {
+                sim_->advanceTo(simDeadline);
+                return 0;
+            }
+            sim_->step();
+            continue;
+        }
+
+        int wait = -1;
+        if (timeout_ms > 0) {
+            wait = int(deadline - nowMs());
+            if (wait <= 0)
+                return 0;
+        }
+        const int ret = waitReadable(wait);
+        if (ret < 0)
+            return ret;
+    }
+}
+
+void Device::flush() {
+    if (ctrl_) {
+        cursor_ = __atomic_load_n(&ctrl_->head, __ATOMIC_ACQUIRE);
+        gap_ = false;
+        // consume the pending POLLIN for what we just skipped
+        if (!sim_)
+            waitReadable(0);
+        return;
+    }
+    Sample buf[64];
+    while (::read(fd_, buf, sizeof(buf)) > 0) {
+    }
+}
+
+int Device::getConfig(Config* out) {
+    if (sim_)
+        return sim_->getConfig(out);
+    if (::ioctl(fd_, SIMTEMP_IOC_GET_CONFIG, out) == 0)
+        return 0;
+    if (errno != ENOTTY)
+        return -errno;
+
+    // driver without the config ioctl: assemble it from sysfs
+    Config c{};
+    long long v;
+    for (const ConfigAttr& a : kConfigAttrs) {
+        if (sysfs_.readInt(a.name, &v) == 0)
+            c.*a.field = __u32(v);
+    }
+    int ret = sysfs_.readInt("threshold_mC", &v);
+    if (ret)
+        return ret;
+    c.threshold_mC = __s32(v);
+    std::string mode;
+    ret = sysfs_.read("mode", &mode);
+    if (ret)
+        return ret;
+    for (size_t i = 0; i < sizeof(kModeNames) / sizeof(kModeNames[0]); ++i) {
+        if (mode == kModeNames[i])
+            c.mode = __u32(i);
+    }
+    *out = c;
+    return 0;
+}
+
+int Device::setConfig(const Config& cfg) {
+    if (sim_)
+        return sim_->setConfig(cfg);
+    if (::ioctl(fd_, SIMTEMP_IOC_SET_CONFIG, &cfg) == 0)
+        return 0;
+    if (errno != ENOTTY)
+        return -errno;
+
+    // one attribute at a time: not atomic, unlike the ioctl
+    int ret = sysfs_.writeInt("sampling_us", cfg.period_us);
+    if (!ret)
+        ret = sysfs_.writeInt("threshold_mC", cfg.threshold_mC);
+    if (!ret)
+        ret = sysfs_.writeInt("mode", cfg.mode);
+    for (const ConfigAttr& a : kConfigAttrs) {
+        if (!ret && std::strcmp(a.name, "sampling_us") != 0)
+            ret = sysfs_.writeInt(a.name, cfg.*a.field);
+    }
+    return ret;
+}
+
+int Device::getStats(Stats* out) {
+    if (sim_)
+        return sim_->getStats(out);
+    if (::ioctl(fd_, SIMTEMP_IOC_GET_STATS, out) == 0)
+        return 0;
+    if (errno != ENOTTY)
+        return -errno;
+    return sysfs_.stats(out);
+}
+
+int Device::getEvent(Event* out) {
+    if (sim_)
+        return sim_->popEvent(&evCursor_, out);
+    return ::ioctl(fd_, SIMTEMP_IOC_GET_EVENT, out) == 0 ? 0 : -errno;
+}
+
+int Device::getPerf(Perf* out) {
+    if (sim_)
+        sim_->getPerf(out);
+    else if (::ioctl(fd_, SIMTEMP_IOC_GET_PERF, out) != 0)
+        return -errno;
+
+    if (ctrl_) {
+        out->delivered = delivered_;
+        out->bytes = delivered_ * sizeof(Sample);
+        out->drops = lost_;
+        out->reads = reads_;
+        out->ring_high_water = std::max(out->ring_high_water, maxBacklog_);
+    }
+    return 0;
+}
+
+int Device::setFormat(uint32_t format) {
+    if (ctrl_)
+        return -EBUSY;
+    if (::ioctl(fd_, SIMTEMP_IOC_SET_FORMAT, &format) != 0)
+        return -errno;
+    format_ = format;
+    return 0;
+}
+
+int Device::setStream(uint32_t stream) {
+    if (ctrl_)
+        return -EBUSY;
+    if (::ioctl(fd_, SIMTEMP_IOC_SET_STREAM, &stream) != 0)
+        return -errno;
+    stream_ = stream;
+    return 0;
+}
+
+}  // namespace simtemp
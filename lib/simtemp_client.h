@@ -0,0 +1,174 @@
+// simtemp_client.h - C++ client library for /dev/simtemp* (libsimtemp)
+//
+// One place for device access, shared by the GUI, the tests and tools:
+//   simtemp::Sysfs  - config/stats attributes through cached file descriptors
+//   simtemp::Device - RAII handle: batched reads, streaming, ioctl config/stats
+//   simtemp::SimSensor (simtemp_sim.h) - the driver modelled in user space
+//
+// Device reads come from the shared mmap ring when the driver offers one
+// (no syscall while data is queued) and fall back to read() otherwise;
+// config and stats use the binary ioctls and fall back to sysfs. Runtime
+// calls return 0 (or a count) on success and -errno on failure, like the
+// syscalls underneath; only the Device constructor throws. A Device built
+// on a SimSensor needs no module: it reads the sensor's ring and waiting
+// runs the sensor's virtual clock instead of sleeping.
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+
+#include "nxp_simtemp.h"
+
+namespace simtemp {
+
+using Sample = simtemp_sample;
+using Config = simtemp_config;
+using Stats = simtemp_stats;
+using Event = simtemp_event;
+using Perf = simtemp_perf;
+
+class SimSensor;
+
+// "simtemp" -> /dev/simtemp and /sys/class/misc/simtemp
+std::string devicePath(const std::string& name);
+std::string sysfsPath(const std::string& name);
+
+class Sysfs {
+public:
+    explicit Sysfs(const std::string& name = "simtemp");
+    ~Sysfs();
+    Sysfs(const Sysfs&) = delete;
+    Sysfs& operator=(const Sysfs&) = delete;
+
+    bool present() const;
+
+    // Attribute value without the trailing newline. Each attribute is opened
+    // once and re-read with pread() at offset 0, which makes sysfs refresh it.
+    int read(const std::string& attr, std::string* value);
+    // A newline is appended unless @value already ends in one; an empty value
+    // is written as zero bytes.
+    int write(const std::string& attr, const std::string& value);
+
+    int readInt(const std::string& attr, long long* value);
+    int writeInt(const std::string& attr, long long value);
+
+    // Parsed `stats` attribute; fields the driver does not print stay zero.
+    int stats(Stats* out);
+
+    // Drop the cached descriptors, e.g. after the module was reloaded.
+    void close();
+
+private:
+    struct Fds {
+        int rd = -1;
+        int wr = -1;
+    };
+    Fds& fds(const std::string& attr);
+
+    std::string base_;
+    std::unordered_map<std::string, Fds> fds_;
+};
+
+class Device {
+public:
+    enum class Transport {
+        Auto,  // mmap ring if the driver exposes one, else read()
+        Read,  // always read(); required for setFormat()/setStream()
+    };
+
+    // Opens /dev/<name> non-blocking; throws std::system_error on failure.
+    explicit Device(const std::string& name = "simtemp", Transport transport = Transport::Auto);
+    // Reads @sim like its mmap ring; @sim must outlive the Device.
+    explicit Device(SimSensor& sim);
+    ~Device();
+    Device(const Device&) = delete;
+    Device& operator=(const Device&) = delete;
+
+    int fd() const { return fd_; }
+    const std::string& name() const { return name_; }
+    bool mapped() const { return ctrl_ != nullptr; }
+    bool simulated() const { return sim_ != nullptr; }
+    Sysfs& sysfs() { return sysfs_; }
+
+    // Up to @max samples. Waits up to @timeout_ms for the first one (-1:
+    // forever, 0: don't wait) and returns 0 on timeout. A record that
+    // follows lost samples carries SIMTEMP_FLAG_OVERRUN on either transport.
+    // On a SimSensor the timeout is virtual time, and -1 gives up after a
+    // virtual minute so a stream the deadband silenced cannot hang a test.
+    // -EINVAL while setFormat()/setStream() select records other than
+    // Sample; read those from fd() directly.
+    ssize_t read(Sample* out, size_t max, int timeout_ms = -1);
+
+    // Calls fn(const Sample* batch, size_t count) for every batch until it
+    // returns false; returns 0 then, -errno on a read error, or -ETIMEDOUT
+    // when nothing arrives within @timeout_ms.
+    template <typename Fn>
+    int stream(Fn&& fn, size_t batch = 256, int timeout_ms = -1);
+
+    // Samples the mmap consumer found overwritten before it got to them.
+    uint64_t lost() const { return lost_; }
+
+    // Discard everything queued so the next read starts with new data.
+    void flush();
+
+    int getConfig(Config* out);
+    int setConfig(const Config& cfg);
+    int getStats(Stats* out);
+    int getEvent(Event* out);
+    // SIMTEMP_IOC_GET_PERF. While reading through the ring the driver
+    // cannot see this handle's consumption, so the per-file half is
+    // filled in from the Device's own counters.
+    int getPerf(Perf* out);
+    // Per-file read() format/stream; -EBUSY while reading through the ring.
+    // Anything but SIMTEMP_FORMAT_V1/SIMTEMP_STREAM_RAW turns read() off.
+    int setFormat(uint32_t format);
+    int setStream(uint32_t stream);
+
+private:
+    void mapRing();
+    void unmapRing();
+    ssize_t readRing(Sample* out, size_t max);
+    int waitReadable(int timeout_ms);
+
+    std::string name_;
+    int fd_ = -1;
+    Sysfs sysfs_;
+    SimSensor* sim_ = nullptr;
+    uint32_t evCursor_ = 0;  // sim: this handle's place in the event queue
+    uint32_t format_ = SIMTEMP_FORMAT_V1;
+    uint32_t stream_ = SIMTEMP_STREAM_RAW;
+
+    // mmap transport
+    const simtemp_ring_ctrl* ctrl_ = nullptr;
+    const Sample* ring_ = nullptr;
+    size_t mapLen_ = 0;
+    uint32_t capacity_ = 0;
+    uint32_t cursor_ = 0;
+    bool gap_ = false;
+    uint64_t lost_ = 0;
+    uint64_t delivered_ = 0;
+    uint64_t reads_ = 0;
+    uint32_t maxBacklog_ = 0;
+};
+
+template <typename Fn>
+int Device::stream(Fn&& fn, size_t batch, int timeout_ms) {
+    Sample buf[256];
+    if (batch == 0 || batch > sizeof(buf) / sizeof(buf[0]))
+        batch = sizeof(buf) / sizeof(buf[0]);
+    for (;;) {
+        const ssize_t n = read(buf, batch, timeout_ms);
+        if (n < 0)
+            return int(n);
+        if (n == 0)
+            return -ETIMEDOUT;
+        if (!fn(static_cast<const Sample*>(buf), size_t(n)))
+            return 0;
+    }
+}
+
+}  // namespace simtemp
@@ -0,0 +1,307 @@
+// simtemp_sim.cpp - libsimtemp's user-space driver model (see simtemp_sim.h)
+//
+// Function for function this follows the producer in kernel/nxp_simtemp.c;
+// keep the two in step when the driver changes.
+
+#include "simtemp_sim.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace simtemp {
+
+namespace {
+
+// driver constants (kernel/nxp_simtemp.c)
+constexpr uint32_t kRingSizeMin = 16;
+constexpr uint32_t kRingSizeMax = 1u << 24;
+constexpr uint32_t kPeriodUsMin = 20;
+constexpr uint32_t kPeriodUsMax = 10000000;
+constexpr uint32_t kBurstMax = 4096;
+constexpr uint32_t kWakeLatencyUsMax = 10000000;
+constexpr uint32_t kWindowUsMin = 1000;
+constexpr uint32_t kWindowUsMax = 60000000;
+constexpr uint32_t kWaveAmpMax = 50000;
+constexpr uint32_t kWaveUsMin = 1000;
+constexpr uint32_t kWaveUsMax = 60000000;
+constexpr uint32_t kDeadbandMax = 100000;
+constexpr uint32_t kHeartbeatUsMax = 60000000;
+constexpr int32_t kBaseMc = 25000;
+constexpr int kWaveShift = 10;
+constexpr int kWaveLen = 1 << kWaveShift;
+
+// mapping layout: control block, then the slots (like the driver's page split)
+constexpr size_t kDataOffset = 64;
+static_assert(sizeof(simtemp_ring_ctrl) <= kDataOffset, "ring ctrl fits before the data");
+
+// One cycle each of sine, step and saw in Q15, as simtemp_wave_init() builds them.
+struct WaveTables {
+    int16_t tab[3][kWaveLen];
+
+    WaveTables() {
+        for (int i = 0; i < kWaveLen; ++i) {
+            tab[0][i] = int16_t(std::sin(2.0 * M_PI * i / kWaveLen) * 32767.0);
+            tab[1][i] = i < kWaveLen / 2 ? 32767 : -32767;
+            tab[2][i] = int16_t(-32767 + (2 * 32767 * i) / (kWaveLen - 1));
+        }
+    }
+};
+
+const WaveTables& waveTables() {
+    static const WaveTables t;
+    return t;
+}
+
+uint32_t ringSize(uint32_t want) {
+    uint32_t size = kRingSizeMin;
+    while (size < want && size < kRingSizeMax)
+        size <<= 1;
+    return size;
+}
+
+}  // namespace
+
+SimSensor::SimSensor(uint32_t ring_size, uint32_t seed)
+    : size_(ringSize(ring_size)),
+      now_ns_(1000000000ull),
+      prng_(seed | 1) {
+    mem_.assign((kDataOffset + size_t(size_) * sizeof(simtemp_sample)) / sizeof(uint64_t), 0);
+    simtemp_ring_ctrl* c = mutableCtrl();
+    c->magic = SIMTEMP_RING_MAGIC;
+    c->version = SIMTEMP_RING_VERSION;
+    c->capacity = size_;
+    c->record_size = sizeof(simtemp_sample);
+    c->data_offset = kDataOffset;
+
+    // the driver's probe-time defaults
+    cfg_.period_us = 100000;
+    cfg_.burst = 1;
+    cfg_.threshold_mC = 45000;
+    cfg_.mode = SIMTEMP_MODE_RAMP;
+    cfg_.wakeup_watermark = 1;
+    cfg_.window_us = 1000000;
+    cfg_.wave_amplitude_mC = 10000;
+    cfg_.wave_period_us = 1000000;
+    next_ns_ = now_ns_ + uint64_t(cfg_.period_us) * 1000;
+    std::memset(events_, 0, sizeof(events_));
+    waveTables();
+}
+
+const simtemp_ring_ctrl* SimSensor::ctrl() const {
+    return reinterpret_cast<const simtemp_ring_ctrl*>(mem_.data());
+}
+
+simtemp_ring_ctrl* SimSensor::mutableCtrl() {
+    return reinterpret_cast<simtemp_ring_ctrl*>(mem_.data());
+}
+
+const simtemp_sample* SimSensor::ring() const {
+    return reinterpret_cast<const simtemp_sample*>(
+        reinterpret_cast<const char*>(mem_.data()) + kDataOffset);
+}
+
+simtemp_sample* SimSensor::slot(uint32_t seq) {
+    return const_cast<simtemp_sample*>(ring()) + (seq & (size_ - 1));
+}
+
+void SimSensor::advanceTo(uint64_t t_ns) {
+    // expiries and the wakeup latency timer, in time order
+    for (;;) {
+        if (flush_ns_ && flush_ns_ <= next_ns_ && flush_ns_ <= t_ns) {
+            now_ns_ = std::max(now_ns_, flush_ns_);
+            flush_ns_ = 0;
+            const uint32_t head = ctrl()->head;
+            if (head != wake_head_) {
+                wake_head_ = head;
+                ++stats_.wakeups;
+            }
+            continue;
+        }
+        if (next_ns_ > t_ns)
+            break;
+        now_ns_ = next_ns_;
+        produce(next_ns_);
+        next_ns_ += uint64_t(cfg_.period_us) * 1000;
+    }
+    now_ns_ = std::max(now_ns_, t_ns);
+}
+
+int SimSensor::getConfig(simtemp_config* out) const {
+    *out = cfg_;
+    return 0;
+}
+
+// simtemp_config_check()
+int SimSensor::setConfig(const simtemp_config& c) {
+    const uint32_t cap = size_ - 1;
+    if (c.period_us < kPeriodUsMin || c.period_us > kPeriodUsMax ||
+        c.threshold_mC < -50000 || c.threshold_mC > 150000 ||
+        c.mode > SIMTEMP_MODE_REPLAY ||
+        c.wave_amplitude_mC > kWaveAmpMax ||
+        c.wave_period_us < kWaveUsMin || c.wave_period_us > kWaveUsMax ||
+        c.burst < 1 || c.burst > kBurstMax || c.burst > cap ||
+        c.wakeup_watermark < 1 || c.wakeup_watermark > cap ||
+        c.wakeup_latency_us > kWakeLatencyUsMax ||
+        c.timer_slack_us > kPeriodUsMax ||
+        c.deadband_mC > kDeadbandMax ||
+        c.heartbeat_us > kHeartbeatUsMax ||
+        (c.window_us && (c.window_us < kWindowUsMin || c.window_us > kWindowUsMax)) ||
+        c.reserved[0] || c.reserved[1])
+        return -EINVAL;
+    // simtemp_config_apply(): a new period restarts the timer from now
+    const bool restart = c.period_us != cfg_.period_us;
+    cfg_ = c;
+    if (restart)
+        next_ns_ = now_ns_ + uint64_t(cfg_.period_us) * 1000;
+    return 0;
+}
+
+int SimSensor::getStats(simtemp_stats* out) const {
+    *out = stats_;
+    return 0;
+}
+
+int SimSensor::getPerf(simtemp_perf* out) const {
+    *out = simtemp_perf{};
+    out->timestamp_ns = now_ns_;
+    out->total_samples = stats_.total_samples;
+    out->ring_overwrites = stats_.ring_overwrites;
+    out->wakeups = stats_.wakeups;
+    out->ring_high_water = high_water_;
+    out->readers = readers_;
+    return 0;
+}
+
+int SimSensor::popEvent(uint32_t* cursor, simtemp_event* out) const {
+    if (ev_head_ == *cursor)
+        return -EAGAIN;
+    bool lost = false;
+    if (ev_head_ - *cursor > SIMTEMP_EVENT_QUEUE) {
+        *cursor = ev_head_ - SIMTEMP_EVENT_QUEUE;
+        lost = true;
+    }
+    *out = events_[*cursor & (SIMTEMP_EVENT_QUEUE - 1)];
+    ++*cursor;
+    if (lost)
+        out->flags |= SIMTEMP_EVENT_OVERRUN;
+    return 0;
+}
+
+// simtemp_generate(); replay has no trace loaded here, so it reads like normal
+int32_t SimSensor::generate(uint32_t phase_step) {
+    switch (cfg_.mode) {
+    case SIMTEMP_MODE_NOISY:
+        prng_ ^= prng_ << 13;
+        prng_ ^= prng_ >> 17;
+        prng_ ^= prng_ << 5;
+        return kBaseMc - 5000 + int32_t((uint64_t(prng_) * 10000) >> 32);
+
+    case SIMTEMP_MODE_RAMP:
+        ramp_mC_ += 123;
+        if (ramp_mC_ > 45000) ramp_mC_ = 20000;
+        return ramp_mC_;
+
+    case SIMTEMP_MODE_SINE:
+    case SIMTEMP_MODE_STEP:
+    case SIMTEMP_MODE_SAW: {
+        const int16_t q = waveTables().tab[cfg_.mode - SIMTEMP_MODE_SINE][wave_phase_ >> (32 - kWaveShift)];
+        wave_phase_ += phase_step;
+        return kBaseMc + ((int32_t(cfg_.wave_amplitude_mC) * q) >> 15);
+    }
+
+    default:
+        return kBaseMc;
+    }
+}
+
+// simtemp_check_threshold() + simtemp_push_event()
+bool SimSensor::checkThreshold(simtemp_sample* s, uint32_t seq) {
+    const bool above = s->temp_mC > cfg_.threshold_mC;
+    if (above == above_threshold_)
+        return false;
+
+    s->flags |= SIMTEMP_FLAG_THRESHOLD;
+    above_threshold_ = above;
+    ++stats_.threshold_crossings;
+
+    simtemp_event& ev = events_[ev_head_ & (SIMTEMP_EVENT_QUEUE - 1)];
+    ev.timestamp_ns = s->timestamp_ns;
+    ev.seq = seq;
+    ev.temp_mC = s->temp_mC;
+    ev.threshold_mC = cfg_.threshold_mC;
+    ev.flags = above ? SIMTEMP_EVENT_RISING : 0;
+    ++ev_head_;
+    return true;
+}
+
+// simtemp_deadband_pass()
+bool SimSensor::deadbandPass(const simtemp_sample* s) {
+    if (cfg_.deadband_mC && db_valid_ &&
+        uint32_t(std::abs(s->temp_mC - db_last_mC_)) < cfg_.deadband_mC &&
+        !(s->flags & SIMTEMP_FLAG_THRESHOLD) &&
+        !(cfg_.heartbeat_us &&
+          s->timestamp_ns - db_last_ns_ >= uint64_t(cfg_.heartbeat_us) * 1000))
+        return false;
+
+    db_valid_ = true;
+    db_last_mC_ = s->temp_mC;
+    db_last_ns_ = s->timestamp_ns;
+    return true;
+}
+
+// simtemp_notify(): only the wakeups counter is observable here
+void SimSensor::notify(uint32_t head) {
+    if (head - wake_head_ >= cfg_.wakeup_watermark) {
+        wake_head_ = head;
+        ++stats_.wakeups;
+        return;
+    }
+    if (cfg_.wakeup_latency_us && !flush_ns_)
+        flush_ns_ = now_ns_ + uint64_t(cfg_.wakeup_latency_us) * 1000;
+}
+
+// simtemp_produce(): one burst ending at @timestamp_ns, staged so that only
+// the deadband's survivors are reserved; rb_reserve()/rb_commit() inline
+void SimSensor::produce(uint64_t timestamp_ns) {
+    simtemp_ring_ctrl* c = mutableCtrl();
+    const uint32_t n = cfg_.burst;
+    const uint64_t step = uint64_t(cfg_.period_us) * 1000 / n;
+    const uint32_t phase_step =
+        uint32_t((uint64_t(cfg_.period_us) << 32) / (uint64_t(cfg_.wave_period_us) * n));
+
+    const uint32_t head = c->head;
+    stage_.resize(n);
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        simtemp_sample* s = &stage_[kept];
+        s->timestamp_ns = timestamp_ns - uint64_t(n - 1 - i) * step;
+        s->temp_mC = generate(phase_step);
+        s->flags = SIMTEMP_FLAG_NEW_SAMPLE;
+        checkThreshold(s, head + kept);
+        if (!deadbandPass(s))
+            continue;
+        ++kept;
+    }
+
+    if (kept) {
+        const uint32_t held = head - c->tail;
+        if (held + kept > size_ - 1) {
+            const uint32_t drop = held + kept - (size_ - 1);
+            c->tail += drop;
+            stats_.ring_overwrites += drop;
+        }
+        __atomic_store_n(&c->reserve, head + kept, __ATOMIC_RELAXED);
+        for (uint32_t i = 0; i < kept; ++i)
+            *slot(head + i) = stage_[i];
+        __atomic_store_n(&c->head, head + kept, __ATOMIC_RELEASE);
+    }
+
+    stats_.total_samples += n;
+    stats_.suppressed += n - kept;
+    notify(head + kept);
+}
+
+}  // namespace simtemp
@@ -0,0 +1,95 @@
+// simtemp_sim.h - user-space model of the simtemp driver, part of libsimtemp
+//
+// SimSensor produces the same record stream as the module, on a virtual
+// clock: nothing happens until the clock is advanced, and then every timer
+// expiry up to the new time runs at once. Generation (all waveform modes
+// but a loaded replay trace), burst spacing, thresholds and events, the
+// deadband/heartbeat filter, config validation and the stats counters
+// follow kernel/nxp_simtemp.c; the records go to a ring with the same
+// layout and protocol as the mmap ring, so simtemp::Device(SimSensor&)
+// reads it with the very consumer code it uses on the real device.
+// The producer is ideal: every expiry is on time and timer_slack_us is
+// not modelled, nor are windows or the V2/COMPACT read() formats.
+//
+// Not thread-safe: the clock, the config and every Device on the sensor
+// belong to one thread.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "nxp_simtemp.h"
+
+namespace simtemp {
+
+class SimSensor {
+public:
+    // @ring_size is rounded up to a power of two within the driver's bounds.
+    explicit SimSensor(uint32_t ring_size = 128, uint32_t seed = 1);
+    SimSensor(const SimSensor&) = delete;
+    SimSensor& operator=(const SimSensor&) = delete;
+
+    // Virtual CLOCK_MONOTONIC in ns; the first expiry is one period after 1 s.
+    uint64_t now() const { return now_ns_; }
+    uint64_t nextExpiry() const { return next_ns_; }
+    // Runs every expiry up to @t_ns (never backwards), then sets the clock to it.
+    void advanceTo(uint64_t t_ns);
+    void advance(uint64_t ns) { advanceTo(now_ns_ + ns); }
+    // Jumps to the next expiry: exactly one burst.
+    void step() { advanceTo(next_ns_); }
+
+    // Same contract as SIMTEMP_IOC_{GET,SET}_CONFIG: -EINVAL leaves the config alone.
+    int getConfig(simtemp_config* out) const;
+    int setConfig(const simtemp_config& cfg);
+    int getStats(simtemp_stats* out) const;
+    // Device half of SIMTEMP_IOC_GET_PERF; the timer never overruns here.
+    int getPerf(simtemp_perf* out) const;
+
+    // For Device: the ring, the event queue and the reader accounting.
+    const simtemp_ring_ctrl* ctrl() const;
+    const simtemp_sample* ring() const;
+    uint32_t eventHead() const { return ev_head_; }
+    // Oldest event after *@cursor, like the per-file queue; -EAGAIN if none.
+    int popEvent(uint32_t* cursor, simtemp_event* out) const;
+    void addReaderOverruns(uint64_t n) { stats_.reader_overruns += n; }
+    void noteBacklog(uint32_t records) { high_water_ = records > high_water_ ? records : high_water_; }
+    void openReader() { ++readers_; }
+    void closeReader() { --readers_; }
+
+private:
+    simtemp_ring_ctrl* mutableCtrl();
+    simtemp_sample* slot(uint32_t seq);
+    void produce(uint64_t timestamp_ns);
+    int32_t generate(uint32_t phase_step);
+    bool checkThreshold(simtemp_sample* s, uint32_t seq);
+    bool deadbandPass(const simtemp_sample* s);
+    void notify(uint32_t head);
+
+    std::vector<uint64_t> mem_;  // ctrl page + data area, 8-byte aligned
+    std::vector<simtemp_sample> stage_;  // one burst before the deadband
+    uint32_t size_;              // ring slots; rb_capacity() is size_ - 1
+    simtemp_config cfg_{};
+    simtemp_stats stats_{};
+    uint32_t high_water_ = 0;
+    uint32_t readers_ = 0;
+    uint64_t now_ns_;
+    uint64_t next_ns_;
+
+    // wakeup coalescing: counts what the driver would have woken
+    uint32_t wake_head_ = 0;
+    uint64_t flush_ns_ = 0;      // pending wakeup_latency_us timer, 0 if none
+
+    bool above_threshold_ = false;
+    int32_t ramp_mC_ = 20000;
+    uint32_t prng_;
+    uint32_t wave_phase_ = 0;
+    bool db_valid_ = false;
+    int32_t db_last_mC_ = 0;
+    uint64_t db_last_ns_ = 0;
+
+    simtemp_event events_[SIMTEMP_EVENT_QUEUE];
+    uint32_t ev_head_ = 0;
+};
+
+}  // namespace simtemp
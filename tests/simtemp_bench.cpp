@@ -0,0 +1,317 @@
+// simtemp_bench.cpp - throughput and latency benchmarks for /dev/simtemp
+//
+// The device benchmarks need the module loaded and write access to sysfs
+// (sudo), like the tests; without the module they are skipped and only
+// BM_Sim* run, against libsimtemp's SimSensor on a virtual clock.
+// Machine-readable results:
+//   simtemp_bench --benchmark_format=json > bench.json
+//   simtemp_bench --benchmark_out=bench.json --benchmark_out_format=json
+// The driver configuration is saved before and restored after the run.
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <memory>
+#include <poll.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "simtemp_client.h"
+#include "simtemp_sim.h"
+
+namespace {
+
+constexpr uint32_t kBenchPeriodUs = 50;  // 20 kHz: the producer is never the bottleneck
+
+bool g_have_device = false;
+
+// Device benchmarks skip themselves when main() found no module.
+bool NeedDevice(benchmark::State& state) {
+    if (!g_have_device)
+        state.SkipWithError("/dev/simtemp not present");
+    return g_have_device;
+}
+
+uint64_t NowNs() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);  // same clock as sample timestamp_ns
+    return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+}
+
+// Raw blocking read() fd, bypassing libsimtemp so the syscall pattern is explicit.
+int OpenBlocking() {
+    return ::open(simtemp::devicePath("simtemp").c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+void ReportRate(benchmark::State& state, uint64_t samples, uint64_t syscalls) {
+    state.counters["samples_per_s"] = benchmark::Counter(double(samples), benchmark::Counter::kIsRate);
+    state.counters["syscalls_per_sample"] = samples ? double(syscalls) / double(samples) : 0.0;
+    state.SetItemsProcessed(int64_t(samples));
+}
+
+// read() of Arg(0) records per call on a blocking fd.
+void BM_BlockingRead(benchmark::State& state) {
+    if (!NeedDevice(state))
+        return;
+    const size_t batch = size_t(state.range(0));
+    const int fd = OpenBlocking();
+    if (fd < 0) {
+        state.SkipWithError("cannot open /dev/simtemp");
+        return;
+    }
+    std::vector<simtemp::Sample> buf(batch);
+    uint64_t samples = 0, syscalls = 0;
+    for (auto _ : state) {
+        const ssize_t n = ::read(fd, buf.data(), batch * sizeof(simtemp::Sample));
+        ++syscalls;
+        if (n < 0) {
+            state.SkipWithError(std::strerror(errno));
+            break;
+        }
+        samples += uint64_t(n) / sizeof(simtemp::Sample);
+        benchmark::DoNotOptimize(buf.data());
+    }
+    ::close(fd);
+    ReportRate(state, samples, syscalls);
+}
+BENCHMARK(BM_BlockingRead)->Arg(1)->Arg(16)->Arg(64)->Arg(256)->UseRealTime();
+
+// poll() then a non-blocking read() of up to Arg(0) records.
+void BM_PollThenRead(benchmark::State& state) {
+    if (!NeedDevice(state))
+        return;
+    const size_t batch = size_t(state.range(0));
+    const int fd = ::open(simtemp::devicePath("simtemp").c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        state.SkipWithError("cannot open /dev/simtemp");
+        return;
+    }
+    std::vector<simtemp::Sample> buf(batch);
+    uint64_t samples = 0, syscalls = 0;
+    for (auto _ : state) {
+        struct pollfd pfd { fd, POLLIN, 0 };
+        ::poll(&pfd, 1, 1000);
+        const ssize_t n = ::read(fd, buf.data(), batch * sizeof(simtemp::Sample));
+        syscalls += 2;
+        if (n > 0)
+            samples += uint64_t(n) / sizeof(simtemp::Sample);
+        benchmark::DoNotOptimize(buf.data());
+    }
+    ::close(fd);
+    ReportRate(state, samples, syscalls);
+}
+BENCHMARK(BM_PollThenRead)->Arg(1)->Arg(256)->UseRealTime();
+
+// libsimtemp over the mmap ring: syscalls are only the poll() when drained.
+void BM_MmapRing(benchmark::State& state) {
+    if (!NeedDevice(state))
+        return;
+    simtemp::Device dev;
+    if (!dev.mapped()) {
+        state.SkipWithError("mmap ring not available");
+        return;
+    }
+    simtemp::Sample buf[256];
+    uint64_t samples = 0, syscalls = 0;
+    for (auto _ : state) {
+        ssize_t n = dev.read(buf, 256, 0);
+        if (n == 0) {
+            ++syscalls;  // the wait below
+            n = dev.read(buf, 256, 1000);
+        }
+        if (n < 0) {
+            state.SkipWithError(std::strerror(int(-n)));
+            break;
+        }
+        samples += uint64_t(n);
+        benchmark::DoNotOptimize(buf);
+    }
+    ReportRate(state, samples, syscalls);
+    state.counters["lost"] = double(dev.lost());
+}
+BENCHMARK(BM_MmapRing)->UseRealTime();
+
+// timestamp_ns -> user-space receipt, one sample per read(); percentiles in µs.
+void BM_EndToEndLatency(benchmark::State& state) {
+    if (!NeedDevice(state))
+        return;
+    simtemp::Device dev("simtemp", state.range(0) ? simtemp::Device::Transport::Auto
+                                                  : simtemp::Device::Transport::Read);
+    std::vector<double> lat_us;
+    lat_us.reserve(1 << 16);
+    dev.flush();
+    for (auto _ : state) {
+        simtemp::Sample s;
+        const ssize_t n = dev.read(&s, 1, 1000);
+        const uint64_t now = NowNs();
+        if (n <= 0) {
+            state.SkipWithError("no sample within 1 s");
+            break;
+        }
+        lat_us.push_back(double(now - s.timestamp_ns) / 1e3);
+    }
+    if (lat_us.empty())
+        return;
+    std::sort(lat_us.begin(), lat_us.end());
+    auto pct = [&](double p) { return lat_us[std::min(lat_us.size() - 1, size_t(p * lat_us.size()))]; };
+    state.counters["p50_us"] = pct(0.50);
+    state.counters["p99_us"] = pct(0.99);
+    state.counters["p999_us"] = pct(0.999);
+    state.counters["max_us"] = lat_us.back();
+}
+BENCHMARK(BM_EndToEndLatency)->ArgName("mmap")->Arg(0)->Arg(1)->UseRealTime();
+
+// Cost of one threshold change: open/write/close, cached sysfs fd, whole-config ioctl.
+void BM_Reconfigure(benchmark::State& state) {
+    if (!NeedDevice(state))
+        return;
+    simtemp::Device dev;
+    simtemp::Config cfg{};
+    if (dev.getConfig(&cfg)) {
+        state.SkipWithError("config ioctl failed");
+        return;
+    }
+    const std::string path = simtemp::sysfsPath("simtemp") + "/threshold_mC";
+    int i = 0;
+    for (auto _ : state) {
+        const int thr = (++i & 1) ? 45000 : 46000;
+        int ret = 0;
+        switch (state.range(0)) {
+        case 0: {
+            const std::string v = std::to_string(thr) + "\n";
+            const int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+            ret = fd < 0 || ::write(fd, v.data(), v.size()) < 0 ? -errno : 0;
+            if (fd >= 0)
+                ::close(fd);
+            break;
+        }
+        case 1:
+            ret = dev.sysfs().writeInt("threshold_mC", thr);
+            break;
+        default:
+            cfg.threshold_mC = thr;
+            ret = dev.setConfig(cfg);
+            break;
+        }
+        if (ret) {
+            state.SkipWithError(std::strerror(-ret));
+            break;
+        }
+    }
+    static const char* const kLabels[] = { "sysfs_open_write_close", "sysfs_cached_fd", "ioctl_set_config" };
+    state.SetLabel(kLabels[state.range(0)]);
+}
+BENCHMARK(BM_Reconfigure)->DenseRange(0, 2);
+
+// N threads, each with its own file (own cursor) consuming the full stream.
+void BM_ConcurrentReaders(benchmark::State& state) {
+    if (!NeedDevice(state))
+        return;
+    const int fd = OpenBlocking();
+    if (fd < 0) {
+        state.SkipWithError("cannot open /dev/simtemp");
+        return;
+    }
+    simtemp::Sample buf[256];
+    uint64_t samples = 0, syscalls = 0;
+    for (auto _ : state) {
+        const ssize_t n = ::read(fd, buf, sizeof(buf));
+        ++syscalls;
+        if (n > 0)
+            samples += uint64_t(n) / sizeof(simtemp::Sample);
+    }
+    ::close(fd);
+    ReportRate(state, samples, syscalls);
+}
+BENCHMARK(BM_ConcurrentReaders)->ThreadRange(1, 8)->UseRealTime();
+
+// The BM_MmapRing consumer against an ideal producer: each read() runs one
+// burst of Arg(0) records on the virtual clock. No module, no syscalls, so
+// the gap to BM_MmapRing is what the driver and the scheduler cost.
+void BM_SimRing(benchmark::State& state) {
+    const uint32_t burst = uint32_t(state.range(0));
+    simtemp::SimSensor sim(4096);
+    simtemp::Config cfg{};
+    sim.getConfig(&cfg);
+    cfg.period_us = kBenchPeriodUs;
+    cfg.burst = burst;
+    cfg.mode = SIMTEMP_MODE_RAMP;
+    if (sim.setConfig(cfg)) {
+        state.SkipWithError("sim config rejected");
+        return;
+    }
+    simtemp::Device dev(sim);
+    std::vector<simtemp::Sample> buf(burst);
+    const uint64_t start_ns = sim.now();
+    uint64_t samples = 0;
+    for (auto _ : state) {
+        const ssize_t n = dev.read(buf.data(), burst, 1000);
+        if (n <= 0) {
+            state.SkipWithError("sim produced nothing");
+            break;
+        }
+        samples += uint64_t(n);
+        benchmark::DoNotOptimize(buf.data());
+    }
+    ReportRate(state, samples, 0);
+    state.counters["virtual_s"] = double(sim.now() - start_ns) / 1e9;
+    state.counters["lost"] = double(dev.lost());
+}
+BENCHMARK(BM_SimRing)->ArgName("burst")->Arg(1)->Arg(16)->Arg(256);
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    std::unique_ptr<simtemp::Device> dev;
+    try {
+        dev.reset(new simtemp::Device);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s; running the simulated benchmarks only\n", e.what());
+        benchmark::AddCustomContext("simtemp_device", "none");
+        benchmark::RunSpecifiedBenchmarks();
+        benchmark::Shutdown();
+        return 0;
+    }
+    g_have_device = true;
+
+    simtemp::Config saved{};
+    if (int ret = dev->getConfig(&saved)) {
+        std::fprintf(stderr, "reading the config failed: %s\n", std::strerror(-ret));
+        return 1;
+    }
+    simtemp::Config bench = saved;
+    bench.period_us = kBenchPeriodUs;
+    bench.burst = 1;
+    bench.wakeup_watermark = 1;
+    bench.wakeup_latency_us = 0;
+    bench.timer_slack_us = 0;
+    bench.deadband_mC = 0;
+    bench.mode = SIMTEMP_MODE_RAMP;
+    if (int ret = dev->setConfig(bench)) {
+        std::fprintf(stderr, "configuring the device failed: %s (need sudo?)\n", std::strerror(-ret));
+        return 1;
+    }
+
+    // recorded in the JSON "context" block, to compare runs across driver versions
+    std::string value;
+    for (const char* attr : { "ring_size", "producer", "cpu" }) {
+        if (dev->sysfs().read(attr, &value) == 0)
+            benchmark::AddCustomContext(std::string("simtemp_") + attr, value);
+    }
+    benchmark::AddCustomContext("simtemp_period_us", std::to_string(bench.period_us));
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    dev->setConfig(saved);
+    return 0;
+}
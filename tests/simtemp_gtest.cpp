@@ -1,37 +1,73 @@
 #include <gtest/gtest.h>
 
 #include <cerrno>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <csignal>
+#include <cstdlib>
 #include <cstring>
 #include <fcntl.h>
 #include <fstream>
+#include <memory>
 #include <poll.h>
 #include <stdexcept>
 #include <string>
+#include <system_error>
 #include <sstream>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <sys/types.h>
 #include <thread>
 #include <unistd.h>
+#include <utility>
 #include <vector>
 
+#include "simtemp_capture.h"
+#include "simtemp_client.h"
+#include "simtemp_sim.h"
+#include "history.h"
+#include "spsc_queue.h"
+
 namespace {
 
 constexpr const char* kDevPath = "/dev/simtemp";          // character device exposed by the driver
 constexpr const char* kSysfsBase = "/sys/class/misc/simtemp"; // sysfs directory for configuration/stats
 
-#pragma pack(push, 1)
-struct SimtempSample {
-    uint64_t timestamp_ns;
-    int32_t temp_mC;
-    uint32_t flags;
-};
-#pragma pack(pop)
+// Record, ioctl and mmap layouts come from the driver's own ABI header.
+using SimtempSample = simtemp_sample;
+using SimtempSampleV2 = simtemp_sample_v2;
+using SimtempCompactHdr = simtemp_compact_hdr;
+using SimtempCompact = simtemp_compact;
+using SimtempRingCtrl = simtemp_ring_ctrl;
+using SimtempEvent = simtemp_event;
+using SimtempConfig = simtemp_config;
+using SimtempBinStats = simtemp_stats;
+using SimtempPerf = simtemp_perf;
+using SimtempWindow = simtemp_window;
+
+constexpr uint32_t kRingMagic = SIMTEMP_RING_MAGIC;
+constexpr uint32_t kEventRising = SIMTEMP_EVENT_RISING;
+constexpr unsigned long kIocGetEvent = SIMTEMP_IOC_GET_EVENT;
+constexpr unsigned long kIocGetConfig = SIMTEMP_IOC_GET_CONFIG;
+constexpr unsigned long kIocSetConfig = SIMTEMP_IOC_SET_CONFIG;
+constexpr unsigned long kIocGetStats = SIMTEMP_IOC_GET_STATS;
+constexpr unsigned long kIocGetPerf = SIMTEMP_IOC_GET_PERF;
+constexpr uint32_t kStreamRaw = SIMTEMP_STREAM_RAW;
+constexpr uint32_t kStreamWindow = SIMTEMP_STREAM_WINDOW;
+constexpr unsigned long kIocSetStream = SIMTEMP_IOC_SET_STREAM;
+constexpr unsigned long kIocSetFormat = SIMTEMP_IOC_SET_FORMAT;
 
 struct SimtempStats {
     long long total_samples = 0;
     long long threshold_crossings = 0;
+    long long ring_overwrites = 0;
+    long long reader_overruns = 0;
+    long long wakeups = 0;
+    long long suppressed = 0;
 };
 
 std::string SysfsPath(const std::string& attr) {
@@ -56,35 +92,22 @@ std::string ReadFile(const std::string& path) {
     return contents;
 }
 
-int WriteAttr(const std::string& attr, const std::string& value) {
-    const std::string path = SysfsPath(attr);
-    // Attributes are small text files: open/write/close is sufficient.
-    int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
-    if (fd < 0) {
-        return -errno;
-    }
-
-    std::string payload = value;
-    if (!payload.empty() && payload.back() != '\n') {
-        payload.push_back('\n');
-    }
-
-    errno = 0;
-    ssize_t written = ::write(fd, payload.data(), payload.size());
-    int saved_errno = errno;
-    ::close(fd);
+// libsimtemp keeps every attribute the tests touch open across calls.
+simtemp::Sysfs& Attrs() {
+    static simtemp::Sysfs sysfs;
+    return sysfs;
+}
 
-    if (written < 0) {
-        return -saved_errno;
-    }
-    if (static_cast<size_t>(written) != payload.size()) {
-        return -EIO;
-    }
-    return 0;
+int WriteAttr(const std::string& attr, const std::string& value) {
+    return Attrs().write(attr, value);
 }
 
 std::string ReadAttr(const std::string& attr) {
-    return ReadFile(SysfsPath(attr));
+    std::string value;
+    if (Attrs().read(attr, &value) != 0) {
+        throw std::runtime_error("Failed to read " + SysfsPath(attr));
+    }
+    return value;
 }
 
 int ReadAttrInt(const std::string& attr) {
@@ -92,18 +115,17 @@ int ReadAttrInt(const std::string& attr) {
 }
 
 SimtempStats ReadStats() {
-    const std::string text = ReadAttr("stats");
-    SimtempStats stats;
-    std::istringstream ss(text);
-    std::string line;
-    while (std::getline(ss, line)) {
-        auto pos = line.find('=');
-        if (pos == std::string::npos) continue;
-        const std::string key = line.substr(0, pos);
-        const long long value = std::stoll(line.substr(pos + 1));
-        if (key == "total_samples") stats.total_samples = value;
-        else if (key == "threshold_crossings") stats.threshold_crossings = value;
+    simtemp::Stats st{};
+    if (Attrs().stats(&st) != 0) {
+        throw std::runtime_error("Failed to read " + SysfsPath("stats"));
     }
+    SimtempStats stats;
+    stats.total_samples = static_cast<long long>(st.total_samples);
+    stats.threshold_crossings = static_cast<long long>(st.threshold_crossings);
+    stats.ring_overwrites = static_cast<long long>(st.ring_overwrites);
+    stats.reader_overruns = static_cast<long long>(st.reader_overruns);
+    stats.wakeups = static_cast<long long>(st.wakeups);
+    stats.suppressed = static_cast<long long>(st.suppressed);
     return stats;
 }
 
@@ -145,6 +167,21 @@ protected:
         original_sampling_ = ReadAttrInt("sampling_ms");
         original_threshold_ = ReadAttrInt("threshold_mC");
         original_mode_ = ReadAttr("mode");
+        original_batch_min_ = ReadAttrInt("batch_min");
+        original_batch_timeout_ = ReadAttrInt("batch_timeout_ms");
+        original_ring_size_ = ReadAttrInt("ring_size");
+        original_sampling_us_ = ReadAttrInt("sampling_us");
+        original_producer_ = ReadAttr("producer");
+        original_burst_ = ReadAttrInt("burst");
+        original_wake_mark_ = ReadAttrInt("wakeup_watermark");
+        original_wake_latency_ = ReadAttrInt("wakeup_latency_us");
+        original_cpu_ = ReadAttrInt("cpu");
+        original_window_ = ReadAttrInt("window_us");
+        original_wave_amplitude_ = ReadAttrInt("wave_amplitude_mC");
+        original_wave_period_ = ReadAttrInt("wave_period_us");
+        original_timer_slack_ = ReadAttrInt("timer_slack_us");
+        original_deadband_ = ReadAttrInt("deadband_mC");
+        original_heartbeat_ = ReadAttrInt("heartbeat_us");
         original_stats_ = ReadStats();
 
         // Keep the device file open for the duration of each test.
@@ -165,10 +202,28 @@ protected:
         // Restore original configuration to avoid leaking state across runs.
         if (dev_fd_ >= 0) {
             WriteAttr("sampling_ms", std::to_string(original_sampling_));
+            WriteAttr("sampling_us", std::to_string(original_sampling_us_));
+            WriteAttr("producer", original_producer_);
+            WriteAttr("burst", std::to_string(original_burst_));
             WriteAttr("threshold_mC", std::to_string(original_threshold_));
             WriteAttr("mode", original_mode_);
+            WriteAttr("batch_min", std::to_string(original_batch_min_));
+            WriteAttr("batch_timeout_ms", std::to_string(original_batch_timeout_));
+            WriteAttr("wakeup_watermark", std::to_string(original_wake_mark_));
+            WriteAttr("wakeup_latency_us", std::to_string(original_wake_latency_));
+            WriteAttr("cpu", std::to_string(original_cpu_));
+            WriteAttr("window_us", std::to_string(original_window_));
+            WriteAttr("wave_amplitude_mC", std::to_string(original_wave_amplitude_));
+            WriteAttr("wave_period_us", std::to_string(original_wave_period_));
+            WriteAttr("timer_slack_us", std::to_string(original_timer_slack_));
+            WriteAttr("deadband_mC", std::to_string(original_deadband_));
+            WriteAttr("heartbeat_us", std::to_string(original_heartbeat_));
             ::close(dev_fd_);
             dev_fd_ = -1;
+            // The ring can only be resized while nobody holds the device open.
+            if (ReadAttrInt("ring_size") != original_ring_size_) {
+                WriteAttr("ring_size", std::to_string(original_ring_size_));
+            }
         }
     }
 
@@ -191,6 +246,21 @@ protected:
     int original_sampling_{};
     int original_threshold_{};
     std::string original_mode_;
+    int original_batch_min_{};
+    int original_batch_timeout_{};
+    int original_ring_size_{};
+    int original_sampling_us_{};
+    std::string original_producer_;
+    int original_burst_{};
+    int original_wake_mark_{};
+    int original_wake_latency_{};
+    int original_cpu_{};
+    int original_window_{};
+    int original_wave_amplitude_{};
+    int original_wave_period_{};
+    int original_timer_slack_{};
+    int original_deadband_{};
+    int original_heartbeat_{};
     SimtempStats original_stats_{};
 };
 
@@ -216,45 +286,15 @@ TEST_F(SimtempTest, SysfsAttributeRoundTrip) {
     EXPECT_EQ("ramp", ReadAttr("mode"));
 }
 
-TEST_F(SimtempTest, SamplesContainExpectedFlagsAndRange) {
-    // Ramp mode should periodically generate threshold crossing events.
-    ASSERT_EQ(0, WriteAttr("mode", "ramp"));
-    ASSERT_EQ(0, WriteAttr("sampling_ms", "5"));
-    const int threshold = 30000;
-    ASSERT_EQ(0, WriteAttr("threshold_mC", std::to_string(threshold)));
+TEST_F(SimtempTest, BurstAndDeadbandAttributesValidate) {
+    ASSERT_EQ(0, WriteAttr("burst", "10"));
+    EXPECT_EQ(10, ReadAttrInt("burst"));
+    EXPECT_EQ(-EINVAL, WriteAttr("burst", "0"));
+    EXPECT_EQ(10, ReadAttrInt("burst"));
 
-    // Allow new configuration to take effect.
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
-    FlushDevice();
-
-    int fd = dev_fd_;
-    constexpr int kSampleBudget = 600;
-    bool crossing_seen = false;
-    bool has_previous = false;
-    SimtempSample previous{};
-
-    for (int i = 0; i < kSampleBudget; ++i) {
-        SimtempSample s{};
-        ASSERT_TRUE(WaitForSample(fd, &s, 200)) << "timeout waiting for sample " << i;
-        EXPECT_NE(0u, s.flags & 0x1u) << "NEW_SAMPLE flag should be set";
-        EXPECT_GE(s.temp_mC, 20000);
-        EXPECT_LE(s.temp_mC, 45000);
-        if (s.flags & 0x2u) {
-            crossing_seen = true;
-            if (has_previous) {
-                // Ensure the flag corresponds to a sign change across the threshold.
-                const long long prev_delta = static_cast<long long>(previous.temp_mC) - threshold;
-                const long long curr_delta = static_cast<long long>(s.temp_mC) - threshold;
-                EXPECT_LE(prev_delta * curr_delta, 0)
-                    << "threshold flag should indicate sign change around threshold";
-            }
-            break;
-        }
-        previous = s;
-        has_previous = true;
-    }
-
-    EXPECT_TRUE(crossing_seen) << "Expected at least one threshold crossing flag in ramp mode";
+    ASSERT_EQ(0, WriteAttr("deadband_mC", "500"));
+    EXPECT_EQ(-EINVAL, WriteAttr("deadband_mC", "200000"));
+    EXPECT_EQ(500, ReadAttrInt("deadband_mC"));
 }
 
 TEST_F(SimtempTest, PartialReadIsRejected) {
@@ -272,6 +312,71 @@ TEST_F(SimtempTest, PartialReadIsRejected) {
     EXPECT_EQ(EINVAL, err);
 }
 
+TEST_F(SimtempTest, ReadIntoUnmappedPageFailsWithEfault) {
+    // Buffer: two records at the end of one page, then an unmapped page.
+    const size_t page = size_t(::sysconf(_SC_PAGESIZE));
+    char* area = static_cast<char*>(
+        ::mmap(nullptr, 3 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    ASSERT_NE(MAP_FAILED, area);
+    ASSERT_EQ(0, ::munmap(area + page, page));
+
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "1"));
+    FlushDevice();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    SimtempPerf before{};
+    ASSERT_EQ(0, ::ioctl(dev_fd_, kIocGetPerf, &before)) << std::strerror(errno);
+
+    // The first chunk runs into the hole: nothing is delivered, so no EOF-like 0.
+    char* buf = area + page - 2 * sizeof(SimtempSample);
+    errno = 0;
+    const ssize_t n = ::read(dev_fd_, buf, 2 * page);
+    const int err = errno;
+    EXPECT_EQ(-1, n);
+    EXPECT_EQ(EFAULT, err);
+
+    SimtempPerf after{};
+    ASSERT_EQ(0, ::ioctl(dev_fd_, kIocGetPerf, &after));
+    EXPECT_EQ(before.delivered, after.delivered);
+    EXPECT_EQ(before.reads, after.reads);
+
+    // The records are still queued for a good buffer.
+    SimtempSample s{};
+    EXPECT_TRUE(WaitForSample(dev_fd_, &s, 500));
+    ::munmap(area, page);
+    ::munmap(area + 2 * page, page);
+}
+
+TEST_F(SimtempTest, EncodedReadIntoUnmappedPageFailsWithEfault) {
+    // Same as above for the encoded formats, which copy each chunk in one go.
+    const size_t page = size_t(::sysconf(_SC_PAGESIZE));
+    char* area = static_cast<char*>(
+        ::mmap(nullptr, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    ASSERT_NE(MAP_FAILED, area);
+    ASSERT_EQ(0, ::munmap(area + page, page));
+
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "1"));
+    for (uint32_t format : {uint32_t(SIMTEMP_FORMAT_V2), uint32_t(SIMTEMP_FORMAT_COMPACT)}) {
+        ASSERT_EQ(0, ::ioctl(dev_fd_, kIocSetFormat, &format)) << std::strerror(errno);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        SimtempPerf before{};
+        ASSERT_EQ(0, ::ioctl(dev_fd_, kIocGetPerf, &before));
+
+        errno = 0;
+        const ssize_t n = ::read(dev_fd_, area + page - 8, page);
+        const int err = errno;
+        EXPECT_EQ(-1, n) << format;
+        EXPECT_EQ(EFAULT, err) << format;
+
+        SimtempPerf after{};
+        ASSERT_EQ(0, ::ioctl(dev_fd_, kIocGetPerf, &after));
+        EXPECT_EQ(before.delivered, after.delivered) << format;
+        EXPECT_EQ(before.reads, after.reads) << format;
+    }
+    const uint32_t v1 = SIMTEMP_FORMAT_V1;
+    EXPECT_EQ(0, ::ioctl(dev_fd_, kIocSetFormat, &v1));
+    ::munmap(area, page);
+}
+
 TEST_F(SimtempTest, PollSignalsDataAvailable) {
     // poll() must report readable data once a sample arrives.
     ASSERT_EQ(0, WriteAttr("sampling_ms", "20"));
@@ -317,3 +422,1707 @@ TEST_F(SimtempTest, StressReconfigureAndRead) {
     EXPECT_GE(after.threshold_crossings, before.threshold_crossings);
     EXPECT_GE(after.total_samples - before.total_samples, 1);
 }
+
+// Soak: concurrent readers on every transport while another thread keeps
+// reconfiguring. SIMTEMP_SOAK_SECONDS (default 5) and SIMTEMP_SOAK_READERS
+// (per kind, default 2) scale it up to the minutes/hours runs.
+TEST_F(SimtempTest, SoakConcurrentReadersUnderReconfiguration) {
+    auto env_int = [](const char* name, int fallback) {
+        const char* v = std::getenv(name);
+        return v && *v ? std::max(1, std::atoi(v)) : fallback;
+    };
+    const int seconds = env_int("SIMTEMP_SOAK_SECONDS", 5);
+    const int per_kind = env_int("SIMTEMP_SOAK_READERS", 2);
+
+    ASSERT_EQ(0, WriteAttr("sampling_us", "500"));
+    ASSERT_EQ(0, WriteAttr("wakeup_watermark", "1"));
+    ASSERT_EQ(0, WriteAttr("wakeup_latency_us", "0"));
+    ASSERT_EQ(0, WriteAttr("deadband_mC", "0"));  // every produced sample reaches the ring
+    const SimtempStats before = ReadStats();
+
+    // Per-reader results, checked on the main thread once everyone stopped.
+    struct Result {
+        explicit Result(std::string k) : kind(std::move(k)) {}
+
+        std::string kind;
+        uint64_t received = 0;
+        uint64_t lost = 0;              // sequence gaps (v2) or Device::lost() (mmap)
+        uint64_t unflagged_gaps = 0;    // gap without SIMTEMP_FLAG_OVERRUN
+        uint64_t out_of_order = 0;      // timestamp not strictly increasing
+        uint64_t errors = 0;
+        std::vector<double> early_lat_us, late_lat_us;
+    };
+    std::atomic<bool> stop{false};
+    const auto start = std::chrono::steady_clock::now();
+    const auto duration = std::chrono::seconds(seconds);
+
+    // newest sample of each batch: timestamp -> receipt, first vs last third of the run
+    auto note_latency = [&](Result& r, uint64_t ts_ns) {
+        struct timespec now;
+        ::clock_gettime(CLOCK_MONOTONIC, &now);
+        const double us = (now.tv_sec * 1e9 + now.tv_nsec - double(ts_ns)) / 1e3;
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed < duration / 3)
+            r.early_lat_us.push_back(us);
+        else if (elapsed > duration * 2 / 3)
+            r.late_lat_us.push_back(us);
+    };
+
+    // read() in v2 format: the ring sequence makes every loss visible.
+    auto v2_reader = [&](Result& r, size_t batch) {
+        simtemp::Device dev("simtemp", simtemp::Device::Transport::Read);
+        if (dev.setFormat(SIMTEMP_FORMAT_V2) != 0) {
+            ++r.errors;
+            return;
+        }
+        std::vector<SimtempSampleV2> buf(batch);
+        bool have_prev = false;
+        SimtempSampleV2 prev{};
+        while (!stop.load()) {
+            struct pollfd pfd { dev.fd(), POLLIN, 0 };
+            if (::poll(&pfd, 1, 100) <= 0)
+                continue;
+            const ssize_t n = ::read(dev.fd(), buf.data(), batch * sizeof(SimtempSampleV2));
+            if (n < 0) {
+                if (errno != EAGAIN)
+                    ++r.errors;
+                continue;
+            }
+            const size_t count = size_t(n) / sizeof(SimtempSampleV2);
+            for (size_t i = 0; i < count; ++i) {
+                const SimtempSampleV2& s = buf[i];
+                if (have_prev) {
+                    const uint32_t gap = s.seq - prev.seq - 1;
+                    r.lost += gap;
+                    if (gap && !(s.flags & SIMTEMP_FLAG_OVERRUN))
+                        ++r.unflagged_gaps;
+                    if (s.timestamp_ns <= prev.timestamp_ns)
+                        ++r.out_of_order;
+                }
+                prev = s;
+                have_prev = true;
+            }
+            r.received += count;
+            if (count)
+                note_latency(r, buf[count - 1].timestamp_ns);
+        }
+    };
+
+    // libsimtemp on the mmap ring (no syscall while data is queued).
+    auto mmap_reader = [&](Result& r) {
+        simtemp::Device dev;
+        if (!dev.mapped()) {
+            ++r.errors;
+            return;
+        }
+        simtemp::Sample buf[256];
+        uint64_t last_ts = 0, flagged = 0;
+        while (!stop.load()) {
+            const ssize_t n = dev.read(buf, 256, 100);
+            if (n < 0) {
+                ++r.errors;
+                continue;
+            }
+            for (ssize_t i = 0; i < n; ++i) {
+                if (buf[i].timestamp_ns <= last_ts)
+                    ++r.out_of_order;
+                last_ts = buf[i].timestamp_ns;
+                flagged += (buf[i].flags & SIMTEMP_FLAG_OVERRUN) != 0;
+            }
+            r.received += uint64_t(n);
+            if (n > 0)
+                note_latency(r, buf[n - 1].timestamp_ns);
+        }
+        r.lost = dev.lost();
+        if (r.lost && !flagged)
+            ++r.unflagged_gaps;
+    };
+
+    std::vector<Result> results;
+    for (int i = 0; i < per_kind; ++i) {
+        results.emplace_back("v2 single");
+        results.emplace_back("v2 batched");
+        results.emplace_back("mmap");
+    }
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < results.size(); ++i) {
+        Result& r = results[i];
+        switch (i % 3) {
+        case 0: threads.emplace_back(v2_reader, std::ref(r), 1); break;
+        case 1: threads.emplace_back(v2_reader, std::ref(r), 128); break;
+        default: threads.emplace_back(mmap_reader, std::ref(r)); break;
+        }
+    }
+
+    // Reconfiguration: sysfs stores and whole-config ioctls, interleaved.
+    uint64_t reconfigs = 0, reconfig_errors = 0;
+    std::thread reconfig([&] {
+        simtemp::Sysfs sysfs;
+        simtemp::Device dev("simtemp", simtemp::Device::Transport::Read);
+        const char* const periods[] = { "200", "500", "1000", "2000" };
+        const char* const modes[] = { "noisy", "ramp", "sine", "normal" };
+        const char* const thresholds[] = { "24000", "30000", "40000" };
+        for (unsigned i = 0; !stop.load(); ++i) {
+            int ret;
+            if (i % 4 == 3) {
+                simtemp::Config cfg{};
+                ret = dev.getConfig(&cfg);
+                cfg.burst = (i / 4) % 2 ? 4 : 1;
+                if (!ret)
+                    ret = dev.setConfig(cfg);
+            } else {
+                ret = sysfs.write("sampling_us", periods[i % 4]);
+                if (!ret)
+                    ret = sysfs.write("mode", modes[(i / 3) % 4]);
+                if (!ret)
+                    ret = sysfs.write("threshold_mC", thresholds[i % 3]);
+            }
+            ++reconfigs;
+            reconfig_errors += ret != 0;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+
+    std::this_thread::sleep_for(duration);
+    stop.store(true);
+    reconfig.join();
+    for (auto& t : threads)
+        t.join();
+    const SimtempStats after = ReadStats();
+
+    EXPECT_GT(reconfigs, 0u);
+    EXPECT_EQ(0u, reconfig_errors);
+    const uint64_t produced = uint64_t(after.total_samples - before.total_samples);
+    uint64_t read_lost = 0;
+    for (Result& r : results) {
+        SCOPED_TRACE(r.kind);
+        EXPECT_EQ(0u, r.errors);
+        EXPECT_EQ(0u, r.out_of_order) << "timestamps must increase strictly";
+        EXPECT_EQ(0u, r.unflagged_gaps) << "every loss must be flagged as an overrun";
+        EXPECT_GT(r.received, produced / 10) << "reader starved";
+        // Nothing can be seen or lost that the producer did not make.
+        EXPECT_LE(r.received + r.lost, produced + 1);
+        if (r.kind != "mmap")
+            read_lost += r.lost;
+
+        // Wakeup latency must not drift while the run goes on.
+        if (r.early_lat_us.size() > 10 && r.late_lat_us.size() > 10) {
+            auto median = [](std::vector<double>& v) {
+                std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+                return v[v.size() / 2];
+            };
+            const double early = median(r.early_lat_us), late = median(r.late_lat_us);
+            EXPECT_LT(late, early * 4 + 2000.0) << "median latency " << early << " -> " << late << " us";
+        }
+    }
+    // read() losses are what the driver counted as reader overruns.
+    EXPECT_LE(read_lost, uint64_t(after.reader_overruns - before.reader_overruns));
+}
+
+TEST_F(SimtempTest, BatchedReadReturnsWholeRecords) {
+    // A large buffer should be filled with several records in one read().
+    ASSERT_EQ(0, WriteAttr("mode", "ramp"));
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "2"));
+    FlushDevice();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<SimtempSample> batch(64);
+    // Odd byte count: the trailing partial record must be left untouched.
+    const size_t bytes = batch.size() * sizeof(SimtempSample) + 5;
+    std::vector<char> raw(bytes, 0);
+    ssize_t n = ::read(dev_fd_, raw.data(), raw.size());
+    ASSERT_GT(n, 0);
+    ASSERT_EQ(0, n % static_cast<ssize_t>(sizeof(SimtempSample)));
+    const size_t records = n / sizeof(SimtempSample);
+    EXPECT_GT(records, 1u) << "expected more than one record per read()";
+    std::memcpy(batch.data(), raw.data(), n);
+
+    for (size_t i = 0; i < records; ++i) {
+        EXPECT_NE(0u, batch[i].flags & 0x1u);
+        if (i > 0) {
+            EXPECT_GT(batch[i].timestamp_ns, batch[i - 1].timestamp_ns)
+                << "timestamps must be monotonic within a batch";
+        }
+    }
+}
+
+TEST_F(SimtempTest, BatchMinBlocksUntilBatchIsComplete) {
+    // With batch_min=8 a blocking read must not return a smaller batch.
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "5"));
+    ASSERT_EQ(0, WriteAttr("batch_min", "8"));
+    ASSERT_EQ(0, WriteAttr("batch_timeout_ms", "0"));
+    FlushDevice();
+
+    std::vector<SimtempSample> batch(32);
+    ssize_t n = ::read(dev_fd_, batch.data(), batch.size() * sizeof(SimtempSample));
+    ASSERT_GT(n, 0);
+    EXPECT_GE(static_cast<size_t>(n) / sizeof(SimtempSample), 8u);
+
+    // A short timeout releases the reader with whatever has arrived.
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "50"));
+    ASSERT_EQ(0, WriteAttr("batch_min", "100"));
+    ASSERT_EQ(0, WriteAttr("batch_timeout_ms", "120"));
+    FlushDevice();
+
+    const auto start = std::chrono::steady_clock::now();
+    n = ::read(dev_fd_, batch.data(), batch.size() * sizeof(SimtempSample));
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    ASSERT_GT(n, 0);
+    EXPECT_LT(static_cast<size_t>(n) / sizeof(SimtempSample), 100u);
+    EXPECT_LT(elapsed, std::chrono::milliseconds(1000));
+
+    // Out-of-range values are rejected.
+    EXPECT_EQ(-EINVAL, WriteAttr("batch_min", "0"));
+    EXPECT_EQ(-EINVAL, WriteAttr("batch_timeout_ms", "-1"));
+}
+
+TEST_F(SimtempTest, MmapRingExposesSamplesWithoutRead) {
+    ASSERT_EQ(0, WriteAttr("mode", "ramp"));
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "5"));
+
+    const long page = ::sysconf(_SC_PAGESIZE);
+    void* hdr = ::mmap(nullptr, page, PROT_READ, MAP_SHARED, dev_fd_, 0);
+    ASSERT_NE(MAP_FAILED, hdr) << strerror(errno);
+    const auto* ctrl = static_cast<const SimtempRingCtrl*>(hdr);
+    ASSERT_EQ(kRingMagic, ctrl->magic);
+    ASSERT_EQ(sizeof(SimtempSample), ctrl->record_size);
+    ASSERT_NE(0u, ctrl->capacity);
+    ASSERT_EQ(0u, ctrl->capacity & (ctrl->capacity - 1)) << "capacity must be a power of two";
+
+    const size_t map_len = ctrl->data_offset + ctrl->capacity * sizeof(SimtempSample);
+    const uint32_t capacity = ctrl->capacity;
+    const uint32_t data_offset = ctrl->data_offset;
+    ASSERT_EQ(0, ::munmap(hdr, page));
+
+    void* base = ::mmap(nullptr, map_len, PROT_READ, MAP_SHARED, dev_fd_, 0);
+    ASSERT_NE(MAP_FAILED, base) << strerror(errno);
+    ctrl = static_cast<const SimtempRingCtrl*>(base);
+    const auto* ring = reinterpret_cast<const SimtempSample*>(
+        static_cast<const char*>(base) + data_offset);
+
+    uint32_t cursor = __atomic_load_n(&ctrl->head, __ATOMIC_ACQUIRE);
+    int consumed = 0;
+    uint64_t last_ts = 0;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+
+    while (consumed < 50 && std::chrono::steady_clock::now() < deadline) {
+        uint32_t head = __atomic_load_n(&ctrl->head, __ATOMIC_ACQUIRE);
+        if (head == cursor) {
+            // Ring drained: poll() is only used to sleep.
+            struct pollfd pfd { dev_fd_, POLLIN, 0 };
+            ASSERT_GE(::poll(&pfd, 1, 200), 0);
+            continue;
+        }
+        if (head - cursor >= capacity) {
+            cursor = head - capacity + 1;  // we lagged; skip overwritten records
+        }
+        for (; cursor != head; ++cursor) {
+            SimtempSample s = ring[cursor & (capacity - 1)];
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&ctrl->reserve, __ATOMIC_RELAXED) - cursor >= capacity) {
+                continue;  // overwritten while copying
+            }
+            EXPECT_NE(0u, s.flags & 0x1u);
+            EXPECT_GT(s.timestamp_ns, last_ts);
+            last_ts = s.timestamp_ns;
+            ++consumed;
+        }
+    }
+    EXPECT_GE(consumed, 50) << "mmap consumer saw too few samples";
+    ASSERT_EQ(0, ::munmap(base, map_len));
+}
+
+TEST_F(SimtempTest, MmapRejectsWritableMapping) {
+    int fd = ::open(kDevPath, O_RDWR | O_CLOEXEC);
+    ASSERT_GE(fd, 0) << strerror(errno);
+    const long page = ::sysconf(_SC_PAGESIZE);
+    errno = 0;
+    void* p = ::mmap(nullptr, page, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    ::close(fd);
+    EXPECT_EQ(MAP_FAILED, p);
+    EXPECT_EQ(EPERM, err);
+}
+
+TEST_F(SimtempTest, RingSizeIsConfigurableWhileClosed) {
+    // Resizing is refused while any file (ours) holds a cursor into the ring.
+    EXPECT_EQ(-EBUSY, WriteAttr("ring_size", "4096"));
+
+    ::close(dev_fd_);
+    EXPECT_EQ(-EINVAL, WriteAttr("ring_size", "1000"));   // not a power of two
+    EXPECT_EQ(-EINVAL, WriteAttr("ring_size", "8"));      // below the minimum
+    ASSERT_EQ(0, WriteAttr("ring_size", "1048576"));
+    EXPECT_EQ(1048576, ReadAttrInt("ring_size"));
+
+    dev_fd_ = ::open(kDevPath, O_RDONLY | O_CLOEXEC);
+    ASSERT_GE(dev_fd_, 0);
+
+    const long page = ::sysconf(_SC_PAGESIZE);
+    void* hdr = ::mmap(nullptr, page, PROT_READ, MAP_SHARED, dev_fd_, 0);
+    ASSERT_NE(MAP_FAILED, hdr) << strerror(errno);
+    EXPECT_EQ(1048576u, static_cast<const SimtempRingCtrl*>(hdr)->capacity);
+    ::munmap(hdr, page);
+
+    // A large ring absorbs a consumer stall far longer than 128 samples.
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "1"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    std::vector<SimtempSample> batch(4096);
+    ssize_t n = ::read(dev_fd_, batch.data(), batch.size() * sizeof(SimtempSample));
+    ASSERT_GT(n, 0);
+    const size_t records = n / sizeof(SimtempSample);
+    EXPECT_GT(records, 128u);
+    for (size_t i = 0; i < records; ++i) {
+        EXPECT_EQ(0u, batch[i].flags & 0x4u) << "no overrun expected with a large ring";
+    }
+}
+
+TEST_F(SimtempTest, RingSizeWaitsForMappingsToGo) {
+    // A mapping keeps the ring pinned after its descriptor is closed.
+    const long page = ::sysconf(_SC_PAGESIZE);
+    void* hdr = ::mmap(nullptr, page, PROT_READ, MAP_SHARED, dev_fd_, 0);
+    ASSERT_NE(MAP_FAILED, hdr) << strerror(errno);
+    ::close(dev_fd_);
+    dev_fd_ = -1;
+    const int size = ReadAttrInt("ring_size");
+    const std::string other = std::to_string(size == 1024 ? 2048 : 1024);
+    EXPECT_EQ(-EBUSY, WriteAttr("ring_size", other));
+    EXPECT_EQ(size, ReadAttrInt("ring_size"));
+
+    ::munmap(hdr, page);
+    ASSERT_EQ(0, WriteAttr("ring_size", other));
+    EXPECT_EQ(std::stoi(other), ReadAttrInt("ring_size"));
+
+    // TearDown() restores the size once the device is closed again.
+    dev_fd_ = ::open(kDevPath, O_RDONLY | O_CLOEXEC);
+    ASSERT_GE(dev_fd_, 0);
+}
+
+TEST_F(SimtempTest, SamplingUsAndProducerAttributes) {
+    ASSERT_EQ(0, WriteAttr("sampling_us", "250"));
+    EXPECT_EQ(250, ReadAttrInt("sampling_us"));
+    EXPECT_EQ(0, ReadAttrInt("sampling_ms")) << "sub-ms periods read back as 0 ms";
+
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "7"));
+    EXPECT_EQ(7000, ReadAttrInt("sampling_us"));
+
+    EXPECT_EQ(-EINVAL, WriteAttr("sampling_us", "5"));
+    EXPECT_EQ(7000, ReadAttrInt("sampling_us"));
+
+    ASSERT_EQ(0, WriteAttr("producer", "timer"));
+    EXPECT_EQ("timer", ReadAttr("producer"));
+    ASSERT_EQ(0, WriteAttr("producer", "work"));
+    EXPECT_EQ("work", ReadAttr("producer"));
+    EXPECT_EQ(-EINVAL, WriteAttr("producer", "irq"));
+}
+
+TEST_F(SimtempTest, TimerProducerSustainsSubMillisecondPeriods) {
+    // 10 kHz straight from the hrtimer; timestamps should track the period.
+    ASSERT_EQ(0, WriteAttr("producer", "timer"));
+    ASSERT_EQ(0, WriteAttr("sampling_us", "100"));
+    FlushDevice();
+
+    std::vector<SimtempSample> batch(512);
+    std::vector<uint64_t> gaps;
+    uint64_t prev = 0;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+    while (std::chrono::steady_clock::now() < deadline) {
+        ssize_t n = ::read(dev_fd_, batch.data(), batch.size() * sizeof(SimtempSample));
+        ASSERT_GT(n, 0);
+        for (size_t i = 0; i < static_cast<size_t>(n) / sizeof(SimtempSample); ++i) {
+            if (batch[i].flags & 0x4u) {
+                prev = 0;  // hole in the stream: don't measure across it
+            }
+            if (prev) {
+                gaps.push_back(batch[i].timestamp_ns - prev);
+            }
+            prev = batch[i].timestamp_ns;
+        }
+    }
+
+    ASSERT_GT(gaps.size(), 1000u) << "expected ~3000 samples in 300 ms";
+    std::sort(gaps.begin(), gaps.end());
+    const uint64_t median = gaps[gaps.size() / 2];
+    EXPECT_GT(median, 70'000u);
+    EXPECT_LT(median, 130'000u);
+}
+
+TEST_F(SimtempTest, VectoredNowaitAndSpliceReads) {
+    ASSERT_EQ(0, WriteAttr("mode", "ramp"));
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "2"));
+    FlushDevice();
+
+    // RWF_NOWAIT on a drained reader must not sleep, even on a blocking fd.
+    SimtempSample one{};
+    struct iovec iov_one = {&one, sizeof(one)};
+    errno = 0;
+    ssize_t n = ::preadv2(dev_fd_, &iov_one, 1, -1, RWF_NOWAIT);
+    if (n < 0) {
+        EXPECT_EQ(EAGAIN, errno);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Segment sizes deliberately split records across the two iovecs.
+    std::vector<char> a(3 * sizeof(SimtempSample) + 7), b(5 * sizeof(SimtempSample) - 7);
+    struct iovec iov[2] = {{a.data(), a.size()}, {b.data(), b.size()}};
+    n = ::readv(dev_fd_, iov, 2);
+    ASSERT_EQ(static_cast<ssize_t>(8 * sizeof(SimtempSample)), n);
+
+    std::vector<char> joined(a);
+    joined.insert(joined.end(), b.begin(), b.end());
+    std::vector<SimtempSample> recs(8);
+    std::memcpy(recs.data(), joined.data(), n);
+    for (size_t i = 0; i < recs.size(); ++i) {
+        EXPECT_NE(0u, recs[i].flags & 0x1u);
+        if (i > 0) {
+            EXPECT_GT(recs[i].timestamp_ns, recs[i - 1].timestamp_ns);
+        }
+    }
+
+    // splice() moves whole records into a pipe without a user buffer.
+    int pipefd[2];
+    ASSERT_EQ(0, ::pipe(pipefd));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    n = ::splice(dev_fd_, nullptr, pipefd[1], nullptr, 16 * sizeof(SimtempSample), 0);
+    if (n >= 0) {
+        EXPECT_GT(n, 0);
+        EXPECT_EQ(0, n % static_cast<ssize_t>(sizeof(SimtempSample)));
+    } else {
+        ADD_FAILURE() << "splice failed: " << std::strerror(errno);
+    }
+    ::close(pipefd[0]);
+    ::close(pipefd[1]);
+}
+
+TEST_F(SimtempTest, WakeupWatermarkCoalescesPollAndWakeups) {
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "1"));
+    ASSERT_EQ(0, WriteAttr("wakeup_latency_us", "0"));
+    ASSERT_EQ(0, WriteAttr("wakeup_watermark", "20"));
+    EXPECT_EQ(20, ReadAttrInt("wakeup_watermark"));
+    EXPECT_EQ(-EINVAL, WriteAttr("wakeup_watermark", "0"));
+    EXPECT_EQ(-EINVAL, WriteAttr("wakeup_watermark", "100000000"));
+    FlushDevice();
+
+    // poll() must hold back until 20 records are queued for this reader.
+    const SimtempStats before = ReadStats();
+    struct pollfd pfd = {dev_fd_, POLLIN, 0};
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_EQ(1, ::poll(&pfd, 1, 1000));
+        std::vector<SimtempSample> batch(64);
+        ssize_t n = ::read(dev_fd_, batch.data(), batch.size() * sizeof(SimtempSample));
+        ASSERT_GT(n, 0);
+        EXPECT_GE(static_cast<size_t>(n) / sizeof(SimtempSample), 20u);
+    }
+    const SimtempStats after = ReadStats();
+    const long long samples = after.total_samples - before.total_samples;
+    const long long wakeups = after.wakeups - before.wakeups;
+    ASSERT_GT(wakeups, 0);
+    EXPECT_LE(wakeups * 10, samples) << "expected roughly one wakeup per 20 samples";
+}
+
+TEST_F(SimtempTest, WakeupLatencyDeliversBelowWatermark) {
+    // 20 Hz never reaches a watermark of 100 quickly: the latency bound must.
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "50"));
+    ASSERT_EQ(0, WriteAttr("wakeup_watermark", "100"));
+    ASSERT_EQ(0, WriteAttr("wakeup_latency_us", "20000"));
+    FlushDevice();
+
+    struct pollfd pfd = {dev_fd_, POLLIN, 0};
+    const auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(1, ::poll(&pfd, 1, 1000));
+    const auto waited = std::chrono::steady_clock::now() - start;
+    EXPECT_LT(waited, std::chrono::milliseconds(200));
+
+    SimtempSample s{};
+    EXPECT_EQ(static_cast<ssize_t>(sizeof(s)), ::read(dev_fd_, &s, sizeof(s)));
+}
+
+TEST_F(SimtempTest, ThresholdEventsRaisePollPriAndIoctl) {
+    // Ramp 20..45 °C at 1 kHz crosses 30 °C up and down every ~200 ms.
+    ASSERT_EQ(0, WriteAttr("mode", "ramp"));
+    ASSERT_EQ(0, WriteAttr("threshold_mC", "30000"));
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "1"));
+
+    // Only POLLPRI is asked for: data alone must not wake us.
+    struct pollfd pfd = {dev_fd_, POLLPRI, 0};
+    ASSERT_EQ(1, ::poll(&pfd, 1, 2000));
+    ASSERT_NE(0, pfd.revents & POLLPRI);
+
+    SimtempEvent ev{};
+    ASSERT_EQ(0, ::ioctl(dev_fd_, kIocGetEvent, &ev)) << std::strerror(errno);
+    EXPECT_EQ(30000, ev.threshold_mC);
+    EXPECT_NE(0u, ev.timestamp_ns);
+    if (ev.flags & kEventRising) {
+        EXPECT_GT(ev.temp_mC, ev.threshold_mC);
+    } else {
+        EXPECT_LE(ev.temp_mC, ev.threshold_mC);
+    }
+
+    // Drained in non-blocking mode: -EAGAIN instead of sleeping.
+    const int flags = fcntl(dev_fd_, F_GETFL);
+    ASSERT_EQ(0, fcntl(dev_fd_, F_SETFL, flags | O_NONBLOCK));
+    while (::ioctl(dev_fd_, kIocGetEvent, &ev) == 0) {
+    }
+    EXPECT_EQ(EAGAIN, errno);
+    EXPECT_EQ(-1, ::ioctl(dev_fd_, _IO('S', 99)));
+    EXPECT_EQ(ENOTTY, errno);
+}
+
+TEST_F(SimtempTest, SecondInstanceIsIndependent) {
+    // Only present when the module was loaded with num_devices >= 2.
+    const std::string base1 = "/sys/class/misc/simtemp1";
+    if (!PathExists("/dev/simtemp1") || !PathExists(base1)) {
+        GTEST_SKIP() << "load with num_devices=2 to exercise multiple instances";
+    }
+    auto read1 = [&](const std::string& attr) { return ReadFile(base1 + "/" + attr); };
+    auto write1 = [&](const std::string& attr, const std::string& value) {
+        std::ofstream out(base1 + "/" + attr);
+        out << value << '\n';
+        return static_cast<bool>(out.flush());
+    };
+
+    const std::string original_period = read1("sampling_ms");
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "50"));
+    ASSERT_TRUE(write1("sampling_ms", "5"));
+    EXPECT_EQ("5", read1("sampling_ms"));
+    EXPECT_EQ(50, ReadAttrInt("sampling_ms")) << "instances must not share configuration";
+
+    int fd1 = ::open("/dev/simtemp1", O_RDONLY | O_CLOEXEC);
+    ASSERT_GE(fd1, 0) << std::strerror(errno);
+    SimtempSample s{};
+    EXPECT_TRUE(WaitForSample(fd1, &s, 500));
+    EXPECT_NE(0u, s.flags & 0x1u);
+    ::close(fd1);
+
+    write1("sampling_ms", original_period);
+}
+
+TEST_F(SimtempTest, CpuAttributePlacesProducer) {
+    EXPECT_EQ(-EINVAL, WriteAttr("cpu", "-2"));
+    EXPECT_EQ(-EINVAL, WriteAttr("cpu", std::to_string(sysconf(_SC_NPROCESSORS_CONF) + 1024)));
+
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "5"));
+    ASSERT_EQ(0, WriteAttr("cpu", "0"));
+    EXPECT_EQ(0, ReadAttrInt("cpu"));
+    FlushDevice();
+
+    // Pinned producer keeps delivering, in both producer modes.
+    SimtempSample s{};
+    EXPECT_TRUE(WaitForSample(dev_fd_, &s, 500));
+    ASSERT_EQ(0, WriteAttr("producer", "timer"));
+    FlushDevice();
+    EXPECT_TRUE(WaitForSample(dev_fd_, &s, 500));
+
+    ASSERT_EQ(0, WriteAttr("cpu", "-1"));
+    EXPECT_EQ(-1, ReadAttrInt("cpu"));
+    FlushDevice();
+    EXPECT_TRUE(WaitForSample(dev_fd_, &s, 500));
+}
+
+TEST_F(SimtempTest, ConfigIoctlIsAtomicAndMatchesSysfs) {
+    SimtempConfig cfg{};
+    ASSERT_EQ(0, ::ioctl(dev_fd_, kIocGetConfig, &cfg)) << std::strerror(errno);
+    EXPECT_EQ(static_cast<uint32_t>(ReadAttrInt("sampling_us")), cfg.period_us);
+    EXPECT_EQ(ReadAttrInt("threshold_mC"), cfg.threshold_mC);
+
+    SimtempConfig next = cfg;
+    next.period_us = 5000;
+    next.threshold_mC = 31000;
+    next.mode = 1;  // noisy
+    next.burst = 2;
+    next.wakeup_watermark = 4;
+    next.wakeup_latency_us = 20000;
+    ASSERT_EQ(0, ::ioctl(dev_fd_, kIocSetConfig, &next)) << std::strerror(errno);
+
+    EXPECT_EQ(5, ReadAttrInt("sampling_ms"));
+    EXPECT_EQ(31000, ReadAttrInt("threshold_mC"));
+    EXPECT_EQ("noisy", ReadAttr("mode"));
+    EXPECT_EQ(2, ReadAttrInt("burst"));
+    EXPECT_EQ(4, ReadAttrInt("wakeup_watermark"));
+    EXPECT_EQ(20000, ReadAttrInt("wakeup_latency_us"));
+
+    // One bad field rejects the whole update.
+    SimtempConfig bad = next;
+    bad.threshold_mC = 20000;
+    bad.burst = 0;
+    EXPECT_EQ(-1, ::ioctl(dev_fd_, kIocSetConfig, &bad));
+    EXPECT_EQ(EINVAL, errno);
+    bad = next;
+    bad.reserved[0] = 1;
+    EXPECT_EQ(-1, ::ioctl(dev_fd_, kIocSetConfig, &bad));
+    EXPECT_EQ(EINVAL, errno);
+    EXPECT_EQ(31000, ReadAttrInt("threshold_mC"));
+
+    // Rapid reconfiguration keeps the stream alive.
+    for (int i = 0; i < 200; ++i) {
+        next.threshold_mC = 30000 + i;
+        ASSERT_EQ(0, ::ioctl(dev_fd_, kIocSetConfig, &next));
+    }
+    FlushDevice();
+    SimtempSample sample{};
+    EXPECT_TRUE(WaitForSample(dev_fd_, &sample, 500));
+}
+
+TEST_F(SimtempTest, StatsIoctlTracksSysfsCounters) {
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "2"));
+    SimtempBinStats first{};
+    ASSERT_EQ(0, ::ioctl(dev_fd_, kIocGetStats, &first)) << std::strerror(errno);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const SimtempStats text = ReadStats();
+    SimtempBinStats second{};
+    ASSERT_EQ(0, ::ioctl(dev_fd_, kIocGetStats, &second));
+
+    EXPECT_GT(second.total_samples, first.total_samples);
+    EXPECT_LE(static_cast<long long>(first.total_samples), text.total_samples);
+    EXPECT_GE(static_cast<long long>(second.total_samples), text.total_samples);
+    EXPECT_GE(second.wakeups, first.wakeups);
+}
+
+TEST_F(SimtempTest, PerfIoctlCountsPerFileReadsAndBacklog) {
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "1"));
+    FlushDevice();
+    SimtempPerf before{};
+    ASSERT_EQ(0, ::ioctl(dev_fd_, kIocGetPerf, &before)) << std::strerror(errno);
+    EXPECT_GE(before.readers, 1u);
+
+    // Let ~30 records pile up, then take them 8 per read().
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    SimtempSample buf[8];
+    uint64_t records = 0;
+    for (int i = 0; i < 3; ++i) {
+        const ssize_t n = ::read(dev_fd_, buf, sizeof(buf));
+        ASSERT_GT(n, 0) << std::strerror(errno);
+        records += uint64_t(n) / sizeof(SimtempSample);
+    }
+    SimtempPerf after{};
+    ASSERT_EQ(0, ::ioctl(dev_fd_, kIocGetPerf, &after));
+
+    EXPECT_EQ(records, after.delivered - before.delivered);
+    EXPECT_EQ(records * sizeof(SimtempSample), after.bytes - before.bytes);
+    EXPECT_EQ(3u, after.reads - before.reads);
+    EXPECT_GE(after.ring_high_water, 8u);  // the first read found the backlog
+    EXPECT_GT(after.timestamp_ns, before.timestamp_ns);
+    EXPECT_GT(after.total_samples, before.total_samples);
+    EXPECT_GE(after.timer_overruns, before.timer_overruns);
+    EXPECT_NE(std::string::npos, ReadAttr("stats").find("ring_high_water="));
+}
+
+TEST_F(SimtempTest, LatencyHistogramsFillAndReset) {
+    const std::string dir = "/sys/kernel/debug/simtemp/simtemp";
+    if (!PathExists(dir + "/latency")) {
+        GTEST_SKIP() << "debugfs not mounted or not accessible";
+    }
+    {
+        std::ofstream reset(dir + "/reset");
+        ASSERT_TRUE(reset.is_open());
+        reset << "1\n";
+    }
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "2"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    SimtempSample s{};
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(s)), ::read(dev_fd_, &s, sizeof(s)));
+
+    // header plus at least one populated bucket row
+    std::istringstream table(ReadFile(dir + "/latency"));
+    std::string line;
+    ASSERT_TRUE(std::getline(table, line));
+    EXPECT_NE(std::string::npos, line.find("expiry_to_gen"));
+    EXPECT_NE(std::string::npos, line.find("sample_to_read"));
+    unsigned long long gen_total = 0, read_total = 0;
+    while (std::getline(table, line)) {
+        std::istringstream row(line);
+        std::string bound;
+        unsigned long long gen = 0, pub = 0, read = 0;
+        row >> bound >> gen >> pub >> read;
+        gen_total += gen;
+        read_total += read;
+    }
+    EXPECT_GT(gen_total, 0u);
+    EXPECT_GT(read_total, 0u);
+}
+
+TEST_F(SimtempTest, WindowStreamSummarizesSamples) {
+    ASSERT_EQ(0, WriteAttr("mode", "noisy"));
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "1"));
+    ASSERT_EQ(0, WriteAttr("window_us", "20000"));
+    const uint32_t stream = kStreamWindow;
+    ASSERT_EQ(0, ::ioctl(dev_fd_, kIocSetStream, &stream)) << std::strerror(errno);
+
+    // Raw records are too small for this file now.
+    SimtempSample raw{};
+    EXPECT_EQ(-1, ::read(dev_fd_, &raw, sizeof(raw)));
+    EXPECT_EQ(EINVAL, errno);
+
+    // The first summary may cover a window that started before the switch.
+    SimtempWindow w[3]{};
+    for (auto& one : w) {
+        struct pollfd pfd { dev_fd_, POLLIN, 0 };
+        ASSERT_EQ(1, ::poll(&pfd, 1, 500));
+        ASSERT_EQ(static_cast<ssize_t>(sizeof(one)), ::read(dev_fd_, &one, sizeof(one)));
+    }
+    for (int i = 1; i < 3; ++i) {
+        EXPECT_EQ(20000000u, w[i].end_ns - w[i].start_ns);
+        EXPECT_EQ(0u, w[i].start_ns % 20000000u);
+        EXPECT_EQ(w[i - 1].end_ns, w[i].start_ns);
+        EXPECT_GE(w[i].count, 10u);
+        EXPECT_LE(w[i].count, 21u);
+        EXPECT_LE(w[i].min_mC, w[i].mean_mC);
+        EXPECT_LE(w[i].mean_mC, w[i].max_mC);
+        EXPECT_GE(w[i].min_mC, 20000);
+        EXPECT_LE(w[i].max_mC, 30000);
+    }
+
+    // Back to raw samples on the same file.
+    const uint32_t back = kStreamRaw;
+    ASSERT_EQ(0, ::ioctl(dev_fd_, kIocSetStream, &back));
+    EXPECT_TRUE(WaitForSample(dev_fd_, &raw, 500));
+}
+
+TEST_F(SimtempTest, V2AndCompactFormatsCarryExactSequence) {
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "1"));
+    const uint32_t bogus = 99;
+    EXPECT_EQ(-1, ::ioctl(dev_fd_, kIocSetFormat, &bogus));
+    EXPECT_EQ(EINVAL, errno);
+
+    // v2: consecutive sequence numbers, same payload as v1.
+    const uint32_t v2 = SIMTEMP_FORMAT_V2;
+    ASSERT_EQ(0, ::ioctl(dev_fd_, kIocSetFormat, &v2)) << std::strerror(errno);
+    FlushDevice();
+    SimtempSample small{};
+    EXPECT_EQ(-1, ::read(dev_fd_, &small, sizeof(small)));  // 16 bytes < one v2 record
+    EXPECT_EQ(EINVAL, errno);
+    std::vector<SimtempSampleV2> recs(8);
+    size_t got = 0;
+    while (got < recs.size()) {
+        ssize_t n = ::read(dev_fd_, &recs[got], (recs.size() - got) * sizeof(SimtempSampleV2));
+        ASSERT_GT(n, 0);
+        ASSERT_EQ(0u, n % sizeof(SimtempSampleV2));
+        got += n / sizeof(SimtempSampleV2);
+    }
+    for (size_t i = 1; i < recs.size(); ++i) {
+        EXPECT_EQ(recs[i - 1].seq + 1, recs[i].seq);
+        EXPECT_GT(recs[i].timestamp_ns, recs[i - 1].timestamp_ns);
+        EXPECT_NE(0u, recs[i].flags & SIMTEMP_FLAG_NEW_SAMPLE);
+    }
+
+    // compact: header + 8-byte entries that continue the same sequence.
+    const uint32_t compact = SIMTEMP_FORMAT_COMPACT;
+    ASSERT_EQ(0, ::ioctl(dev_fd_, kIocSetFormat, &compact));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::vector<char> buf(sizeof(SimtempCompactHdr) + 64 * sizeof(SimtempCompact));
+    ssize_t n = ::read(dev_fd_, buf.data(), buf.size());
+    ASSERT_GE(n, static_cast<ssize_t>(sizeof(SimtempCompactHdr) + sizeof(SimtempCompact)));
+    SimtempCompactHdr hdr{};
+    std::memcpy(&hdr, buf.data(), sizeof(hdr));
+    ASSERT_GE(hdr.count, 1u);
+    EXPECT_EQ(n, static_cast<ssize_t>(sizeof(hdr) + hdr.count * sizeof(SimtempCompact)));
+    EXPECT_EQ(recs.back().seq + 1, hdr.seq);
+    uint32_t prev_delta = 0;
+    for (uint16_t i = 0; i < hdr.count; ++i) {
+        SimtempCompact e{};
+        std::memcpy(&e, buf.data() + sizeof(hdr) + i * sizeof(e), sizeof(e));
+        if (i == 0) {
+            EXPECT_EQ(0u, e.delta_ns);
+        }
+        EXPECT_GE(e.delta_ns, prev_delta);
+        prev_delta = e.delta_ns;
+        EXPECT_NE(0u, SIMTEMP_COMPACT_FLAGS(e.value) & SIMTEMP_FLAG_NEW_SAMPLE);
+        EXPECT_GE(SIMTEMP_COMPACT_TEMP(e.value), 20000);
+        EXPECT_LE(SIMTEMP_COMPACT_TEMP(e.value), 45000);
+    }
+}
+
+TEST_F(SimtempTest, TableWaveformsFollowAmplitude) {
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "1"));
+    ASSERT_EQ(0, WriteAttr("wave_amplitude_mC", "5000"));
+    ASSERT_EQ(0, WriteAttr("wave_period_us", "20000"));
+    EXPECT_EQ(-EINVAL, WriteAttr("wave_amplitude_mC", "60000"));
+    EXPECT_EQ(-EINVAL, WriteAttr("wave_period_us", "10"));
+
+    auto collect = [&](const char* mode) {
+        EXPECT_EQ(0, WriteAttr("mode", mode));
+        EXPECT_EQ(mode, ReadAttr("mode"));
+        FlushDevice();
+        std::vector<int32_t> temps;
+        SimtempSample s{};
+        while (temps.size() < 40 && WaitForSample(dev_fd_, &s, 500)) {
+            temps.push_back(s.temp_mC);
+        }
+        return temps;
+    };
+
+    // Two full cycles of a 20 ms sine span nearly the whole amplitude.
+    const auto sine = collect("sine");
+    ASSERT_EQ(40u, sine.size());
+    const auto [lo, hi] = std::minmax_element(sine.begin(), sine.end());
+    EXPECT_GE(*lo, 20000);
+    EXPECT_LE(*hi, 30000);
+    EXPECT_GT(*hi - *lo, 8000);
+
+    // A step wave only ever takes its two levels.
+    for (int32_t t : collect("step")) {
+        EXPECT_GE(std::abs(t - 25000), 4999) << t;
+    }
+
+    // Modes are also accepted by number.
+    ASSERT_EQ(0, WriteAttr("mode", "5"));
+    EXPECT_EQ("saw", ReadAttr("mode"));
+}
+
+TEST_F(SimtempTest, ReplayStreamsLoadedTraceInALoop) {
+    const std::string fw_name = "simtemp_gtest_trace.bin";
+    const std::string fw_path = "/lib/firmware/" + fw_name;
+    const std::vector<int32_t> trace = {21000, 22000, 23000, 24000, 25000};
+    {
+        std::ofstream out(fw_path, std::ios::binary);
+        if (!out.is_open()) {
+            GTEST_SKIP() << "cannot write " << fw_path;
+        }
+        out.write(reinterpret_cast<const char*>(trace.data()), trace.size() * sizeof(int32_t));
+    }
+    ASSERT_EQ(0, WriteAttr("replay_firmware", fw_name));
+    EXPECT_EQ(fw_name + " 5", ReadAttr("replay_firmware"));
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "1"));
+    ASSERT_EQ(0, WriteAttr("mode", "replay"));
+    FlushDevice();
+
+    // Wherever the loop is, each value is followed by its successor.
+    SimtempSample prev{}, s{};
+    ASSERT_TRUE(WaitForSample(dev_fd_, &prev, 500));
+    for (int i = 0; i < 12; ++i) {
+        ASSERT_TRUE(WaitForSample(dev_fd_, &s, 500));
+        const auto it = std::find(trace.begin(), trace.end(), prev.temp_mC);
+        ASSERT_NE(trace.end(), it) << prev.temp_mC;
+        const int32_t next = (it + 1 == trace.end()) ? trace.front() : *(it + 1);
+        EXPECT_EQ(next, s.temp_mC);
+        prev = s;
+    }
+
+    EXPECT_EQ(0, WriteAttr("replay_firmware", "\n"));  // unload
+    EXPECT_EQ("", ReadAttr("replay_firmware"));
+    ::unlink(fw_path.c_str());
+}
+
+TEST_F(SimtempTest, TimerSlackKeepsAverageRate) {
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "10"));
+    ASSERT_EQ(0, WriteAttr("timer_slack_us", "5000"));
+    EXPECT_EQ(5000, ReadAttrInt("timer_slack_us"));
+    EXPECT_EQ(-EINVAL, WriteAttr("timer_slack_us", "20000000"));
+    FlushDevice();
+
+    // Slack only delays expiries; the period itself is kept.
+    SimtempSample first{}, last{};
+    ASSERT_TRUE(WaitForSample(dev_fd_, &first, 500));
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_TRUE(WaitForSample(dev_fd_, &last, 500));
+    }
+    const double avg_ms = (last.timestamp_ns - first.timestamp_ns) / 20.0 / 1e6;
+    EXPECT_GE(avg_ms, 9.5);
+    EXPECT_LE(avg_ms, 16.0);
+}
+
+TEST_F(SimtempTest, EarlyBurstExpiriesKeepTimestampsMonotonic) {
+    // 8 samples per 2 ms expiry are 250 us apart; 1 ms of slack moves
+    // expiries around by more than that.
+    ASSERT_EQ(0, WriteAttr("sampling_us", "2000"));
+    ASSERT_EQ(0, WriteAttr("burst", "8"));
+    ASSERT_EQ(0, WriteAttr("timer_slack_us", "1000"));
+    FlushDevice();
+
+    std::vector<SimtempSample> batch(256);
+    uint64_t prev = 0;
+    size_t total = 0;
+    while (total < 2000) {
+        const ssize_t n = ::read(dev_fd_, batch.data(), batch.size() * sizeof(SimtempSample));
+        ASSERT_GT(n, 0);
+        for (size_t i = 0; i < size_t(n) / sizeof(SimtempSample); ++i) {
+            ASSERT_GT(batch[i].timestamp_ns, prev) << "sample " << total + i;
+            prev = batch[i].timestamp_ns;
+        }
+        total += size_t(n) / sizeof(SimtempSample);
+    }
+}
+
+TEST_F(SimtempTest, ClientLibraryStreamsOverBothTransports) {
+    ASSERT_EQ(0, WriteAttr("mode", "ramp"));
+    ASSERT_EQ(0, WriteAttr("sampling_ms", "2"));
+
+    for (auto transport : {simtemp::Device::Transport::Auto, simtemp::Device::Transport::Read}) {
+        simtemp::Device dev("simtemp", transport);
+        if (transport == simtemp::Device::Transport::Auto) {
+            EXPECT_TRUE(dev.mapped()) << "driver exposes the mmap ring";
+        } else {
+            EXPECT_FALSE(dev.mapped());
+        }
+
+        // Timed-out reads return 0 instead of an error.
+        dev.flush();
+        const SimtempStats before = ReadStats();
+        simtemp::Sample one{};
+        ASSERT_GE(dev.read(&one, 1, 0), 0);
+
+        size_t total = 0;
+        uint64_t last_ts = 0;
+        const int ret = dev.stream([&](const simtemp::Sample* s, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                EXPECT_NE(0u, s[i].flags & SIMTEMP_FLAG_NEW_SAMPLE);
+                EXPECT_GT(s[i].timestamp_ns, last_ts);
+                last_ts = s[i].timestamp_ns;
+            }
+            total += n;
+            return total < 50;
+        }, 16, 500);
+        EXPECT_EQ(0, ret);
+        EXPECT_GE(total, 50u);
+
+        // Config and stats come through the ioctls and agree with sysfs.
+        simtemp::Config cfg{};
+        ASSERT_EQ(0, dev.getConfig(&cfg));
+        EXPECT_EQ(2000u, cfg.period_us);
+        EXPECT_EQ(uint32_t(SIMTEMP_MODE_RAMP), cfg.mode);
+        simtemp::Stats st{};
+        ASSERT_EQ(0, dev.getStats(&st));
+        EXPECT_GE(static_cast<long long>(st.total_samples), before.total_samples + 50);
+
+        // Alternative read() formats need the read() transport.
+        if (dev.mapped()) {
+            EXPECT_EQ(-EBUSY, dev.setFormat(SIMTEMP_FORMAT_V2));
+        } else {
+            // records that are not Samples: Device::read() refuses them
+            ASSERT_EQ(0, dev.setFormat(SIMTEMP_FORMAT_V2));
+            EXPECT_EQ(-EINVAL, dev.read(&one, 1, 0));
+            EXPECT_EQ(0, dev.setFormat(SIMTEMP_FORMAT_V1));
+            EXPECT_GE(dev.read(&one, 1, 0), 0);
+        }
+    }
+    EXPECT_THROW(simtemp::Device("simtemp_missing"), std::system_error);
+}
+
+// HistoryStore needs no device: it is the GUI's long-history decimator.
+TEST(HistoryStoreTest, DecimatedColumnsBoundEverySample) {
+    HistoryStore h;
+    std::vector<float> v;
+    for (int i = 0; i < 100000; ++i) {
+        v.push_back(25.0f + 10.0f * std::sin(i * 0.001f) + (i % 7 == 0 ? 3.0f : 0.0f));
+        h.append(int64_t(i) * 1000, v.back());
+    }
+    ASSERT_EQ(100000u, h.size());
+    EXPECT_EQ(0, h.firstTime());
+    EXPECT_EQ(99999000, h.lastTime());
+
+    // Columns that swallow whole spans, whole blocks, and less than a block.
+    for (int columns : {3, 37, 800, 5000}) {
+        const int64_t t0 = 12345000, t1 = 87654000;
+        std::vector<HistoryStore::Column> out;
+        h.decimate(t0, t1, columns, out);
+        ASSERT_EQ(size_t(columns), out.size()) << columns;
+
+        const double width = double(t1 - t0) / columns;
+        for (int c = 0; c < columns; ++c) {
+            const int64_t lo = t0 + int64_t(std::ceil(c * width));
+            const int64_t hi = c + 1 == columns ? t1 : t0 + int64_t(std::ceil((c + 1) * width));
+            float mn = 1e9f, mx = -1e9f;
+            for (int64_t t = (lo + 999) / 1000 * 1000; t < hi; t += 1000) {
+                mn = std::min(mn, v[t / 1000]);
+                mx = std::max(mx, v[t / 1000]);
+            }
+            EXPECT_FLOAT_EQ(mn, out[c].mn) << columns << " col " << c;
+            EXPECT_FLOAT_EQ(mx, out[c].mx) << columns << " col " << c;
+        }
+    }
+}
+
+TEST(HistoryStoreTest, SparseViewsAndEviction) {
+    HistoryStore h(HistoryStore::BLOCK * 4);
+    std::vector<HistoryStore::Column> out;
+    h.decimate(0, 1000, 10, out);
+    EXPECT_TRUE(out.empty());
+
+    // Two samples far apart: only their columns are emitted.
+    h.append(0, 1.0f);
+    h.append(1000000, 2.0f);
+    h.decimate(0, 2000000, 100, out);
+    ASSERT_EQ(2u, out.size());
+    EXPECT_EQ(1.0f, out[0].mn);
+    EXPECT_EQ(2.0f, out[1].mx);
+
+    // Filling past capacity drops the oldest whole block.
+    for (int i = 2; i < HistoryStore::BLOCK * 4 + 10; ++i)
+        h.append(1000000 + i, float(i));
+    EXPECT_EQ(size_t(HistoryStore::BLOCK * 3 + 10), h.size());
+    EXPECT_EQ(1000000 + HistoryStore::BLOCK, h.firstTime());
+}
+
+TEST(HistoryStoreTest, EvictedSamplesLeaveTheCoarseLevel) {
+    constexpr int kSpan = HistoryStore::BLOCK * HistoryStore::SPAN;
+    HistoryStore h(size_t(kSpan) * 2);
+    // A spike in the first block only: once that block is gone, no
+    // summary may still report it.
+    const int total = kSpan * 2 + HistoryStore::BLOCK * 3;
+    for (int i = 0; i < total; ++i)
+        h.append(int64_t(i) * 1000, i < HistoryStore::BLOCK ? 100.0f : float(i % 50));
+    ASSERT_EQ(size_t(kSpan) * 2, h.size());
+    EXPECT_EQ(int64_t(HistoryStore::BLOCK) * 3 * 1000, h.firstTime());
+
+    std::vector<HistoryStore::Column> out;
+    h.decimate(0, int64_t(total) * 1000, 1, out);
+    ASSERT_EQ(1u, out.size());
+    EXPECT_EQ(0.0f, out[0].mn);
+    EXPECT_EQ(49.0f, out[0].mx);
+
+    // Every column of a coarse view still matches the retained samples.
+    h.decimate(0, int64_t(total) * 1000, 4, out);
+    ASSERT_EQ(4u, out.size());
+    for (const HistoryStore::Column& c : out) {
+        EXPECT_EQ(0.0f, c.mn);
+        EXPECT_EQ(49.0f, c.mx);
+    }
+}
+
+// SpscQueue carries the GUI's sample batches from the reader thread.
+TEST(SpscQueueTest, DeliversEverySlotInOrderAcrossThreads) {
+    struct Slot { uint32_t seq; uint32_t check; };
+    auto q = std::make_unique<SpscQueue<Slot, 8>>();
+    EXPECT_EQ(nullptr, q->front());
+
+    // Full after capacity() pushes, usable again after a pop.
+    for (uint32_t i = 0; i < q->capacity(); ++i) {
+        Slot* s = q->writeSlot();
+        ASSERT_NE(nullptr, s);
+        s->seq = i;
+        q->push();
+    }
+    EXPECT_EQ(nullptr, q->writeSlot());
+    for (uint32_t i = 0; i < q->capacity(); ++i) {
+        ASSERT_NE(nullptr, q->front());
+        EXPECT_EQ(i, q->front()->seq);
+        q->pop();
+    }
+    EXPECT_EQ(nullptr, q->front());
+
+    constexpr uint32_t kCount = 100000;
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < kCount;) {
+            if (Slot* s = q->writeSlot()) {
+                s->seq = i;
+                s->check = ~i;
+                q->push();
+                ++i;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    uint32_t expected = 0;
+    while (expected < kCount) {
+        if (const Slot* s = q->front()) {
+            ASSERT_EQ(expected, s->seq);
+            ASSERT_EQ(~expected, s->check);
+            q->pop();
+            ++expected;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    EXPECT_EQ(nullptr, q->front());
+}
+
+// .stcap captures are plain files: no device needed.
+TEST(CaptureTest, RoundTripsBothCodecsAndSeeksByTime) {
+    // 1 ms period with jitter, a 6 s hole (too big for a u32 delta) and a ramp.
+    std::vector<simtemp_sample> in;
+    uint64_t ts = 1000000000ull;
+    for (int i = 0; i < 10000; ++i) {
+        ts += 1000000 + (i % 3) * 1000 + (i == 5000 ? 6000000000ull : 0);
+        in.push_back({ts, 20000 + (i % 500) * 50, SIMTEMP_FLAG_NEW_SAMPLE | (i % 777 == 0 ? SIMTEMP_FLAG_THRESHOLD : 0u)});
+    }
+    namespace cap = simtemp::capture;
+    const std::string path = ::testing::TempDir() + "simtemp_capture_test.stcap";
+
+    for (cap::Codec codec : {cap::CODEC_RAW, cap::CODEC_PACKED}) {
+        SCOPED_TRACE(codec);
+        cap::Writer w;
+        ASSERT_EQ(0, w.open(path, "simtemp", 1024, codec));
+        ASSERT_EQ(0, w.append(in.data(), 3000));
+        ASSERT_EQ(0, w.append(in.data() + 3000, in.size() - 3000));
+        ASSERT_EQ(0, w.close());
+        if (codec == cap::CODEC_PACKED) {
+            EXPECT_LT(w.bytes(), in.size() * 5) << "packed codec should stay well under raw";
+        }
+
+        cap::Reader r;
+        ASSERT_EQ(0, r.open(path));
+        EXPECT_TRUE(r.indexed());
+        EXPECT_EQ(in.size(), r.samples());
+        EXPECT_STREQ("simtemp", r.header().device);
+        ASSERT_GT(r.chunks(), in.size() / 1024);  // the hole forces an extra chunk
+
+        std::vector<simtemp_sample> out, chunk;
+        for (size_t i = 0; i < r.chunks(); ++i) {
+            ASSERT_EQ(0, r.decode(i, chunk));
+            ASSERT_EQ(r.chunk(i).count, chunk.size());
+            for (const simtemp_sample& s : chunk) {
+                EXPECT_LE(r.chunk(i).min_mC, s.temp_mC);
+                EXPECT_GE(r.chunk(i).max_mC, s.temp_mC);
+            }
+            out.insert(out.end(), chunk.begin(), chunk.end());
+        }
+        ASSERT_EQ(in.size(), out.size());
+        for (size_t i = 0; i < in.size(); ++i) {
+            ASSERT_EQ(in[i].timestamp_ns, out[i].timestamp_ns) << i;
+            ASSERT_EQ(in[i].temp_mC, out[i].temp_mC) << i;
+            ASSERT_EQ(in[i].flags, out[i].flags) << i;
+        }
+
+        // Seeking lands on the chunk holding the timestamp.
+        const size_t c = r.findChunk(in[7000].timestamp_ns);
+        ASSERT_LT(c, r.chunks());
+        EXPECT_LE(r.chunk(c).first_ns, in[7000].timestamp_ns);
+        EXPECT_GE(r.chunk(c).last_ns, in[7000].timestamp_ns);
+        EXPECT_EQ(r.chunks(), r.findChunk(ts + 1));
+
+        const uint32_t* delta;
+        const int32_t* temp;
+        const uint8_t* flags;
+        EXPECT_EQ(codec == cap::CODEC_RAW, r.rawColumns(0, &delta, &temp, &flags));
+    }
+
+    // A capture cut short (no index, torn last chunk) is recovered by scanning.
+    struct stat st {};
+    ASSERT_EQ(0, ::stat(path.c_str(), &st));
+    ASSERT_EQ(0, ::truncate(path.c_str(), st.st_size / 2));
+    cap::Reader r;
+    ASSERT_EQ(0, r.open(path));
+    EXPECT_FALSE(r.indexed());
+    EXPECT_GT(r.chunks(), 0u);
+    std::vector<simtemp_sample> chunk;
+    EXPECT_EQ(0, r.decode(r.chunks() - 1, chunk));
+    EXPECT_EQ(in[r.samples() - 1].timestamp_ns, chunk.back().timestamp_ns);
+    ::unlink(path.c_str());
+}
+
+// SimSensor is the driver modelled in user space on a virtual clock: no
+// module, no sleeping, so these run anywhere in milliseconds.
+TEST(SimBackendTest, StreamsTheDriverRecordStreamOnAVirtualClock) {
+    simtemp::SimSensor sim;
+    simtemp::Config cfg{};
+    ASSERT_EQ(0, sim.getConfig(&cfg));
+    EXPECT_EQ(uint32_t(SIMTEMP_MODE_RAMP), cfg.mode);
+    cfg.period_us = 1000;
+    cfg.threshold_mC = 40000;  // the ramp never goes above 45 °C
+    ASSERT_EQ(0, sim.setConfig(cfg));
+
+    simtemp::Device dev(sim);
+    EXPECT_TRUE(dev.simulated());
+    EXPECT_TRUE(dev.mapped());
+
+    // Nothing happens until the clock moves; a waiting read moves it.
+    simtemp::Sample one{};
+    EXPECT_EQ(0, dev.read(&one, 1, 0));
+    const auto wall_start = std::chrono::steady_clock::now();
+    const uint64_t virt_start = sim.now();
+
+    size_t total = 0;
+    uint64_t crossings = 0, last_ts = 0;
+    const int ret = dev.stream([&](const simtemp::Sample* s, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            EXPECT_NE(0u, s[i].flags & SIMTEMP_FLAG_NEW_SAMPLE);
+            EXPECT_EQ(0u, s[i].flags & SIMTEMP_FLAG_OVERRUN);
+            EXPECT_GE(s[i].temp_mC, 20000);
+            EXPECT_LE(s[i].temp_mC, 45000);
+            if (last_ts) {
+                EXPECT_EQ(1000000u, s[i].timestamp_ns - last_ts);  // an ideal timer
+            }
+            last_ts = s[i].timestamp_ns;
+            crossings += (s[i].flags & SIMTEMP_FLAG_THRESHOLD) != 0;
+        }
+        total += n;
+        return total < 10000;
+    }, 64, 1000);
+    EXPECT_EQ(0, ret);
+    EXPECT_EQ(10000u, total);
+    EXPECT_GE(sim.now() - virt_start, 9999ull * 1000000ull);
+    EXPECT_LT(std::chrono::steady_clock::now() - wall_start, std::chrono::seconds(5));
+
+    simtemp::Stats st{};
+    ASSERT_EQ(0, dev.getStats(&st));
+    EXPECT_EQ(10000u, st.total_samples);
+    EXPECT_EQ(crossings, st.threshold_crossings);
+    EXPECT_EQ(0u, st.reader_overruns);
+
+    // ~100 crossings overflow the 64-entry event queue: the oldest are dropped.
+    ASSERT_GT(crossings, uint64_t(SIMTEMP_EVENT_QUEUE));
+    simtemp::Event ev{};
+    ASSERT_EQ(0, dev.getEvent(&ev));
+    EXPECT_NE(0u, ev.flags & SIMTEMP_EVENT_OVERRUN);
+    EXPECT_EQ(40000, ev.threshold_mC);
+    int events = 1;
+    while (dev.getEvent(&ev) == 0)
+        ++events;
+    EXPECT_EQ(SIMTEMP_EVENT_QUEUE, events);
+    EXPECT_EQ(-EAGAIN, dev.getEvent(&ev));
+}
+
+TEST(SimBackendTest, ConfigIsCheckedLikeTheDriver) {
+    simtemp::SimSensor sim(64);  // 63 usable slots
+    simtemp::Config good{};
+    ASSERT_EQ(0, sim.getConfig(&good));
+    good.period_us = 5000;
+    good.burst = 63;
+    ASSERT_EQ(0, sim.setConfig(good));
+
+    // Every field is checked before anything is applied.
+    std::vector<simtemp::Config> bad(7, good);
+    bad[0].burst = 64;
+    bad[1].wakeup_watermark = 0;
+    bad[2].period_us = 10;
+    bad[3].mode = SIMTEMP_MODE_REPLAY + 1;
+    bad[4].window_us = 500;
+    bad[5].deadband_mC = 200000;
+    bad[6].reserved[1] = 1;
+    for (simtemp::Config& c : bad) {
+        c.threshold_mC = 30000;
+        EXPECT_EQ(-EINVAL, sim.setConfig(c));
+    }
+    simtemp::Config now{};
+    ASSERT_EQ(0, sim.getConfig(&now));
+    EXPECT_EQ(0, std::memcmp(&good, &now, sizeof(now)));
+
+    // A new period restarts the timer from now, like simtemp_config_apply().
+    sim.advance(1234567);
+    good.period_us = 2000;
+    ASSERT_EQ(0, sim.setConfig(good));
+    EXPECT_EQ(sim.now() + 2000000u, sim.nextExpiry());
+    const uint64_t armed = sim.nextExpiry();
+    good.threshold_mC = 30000;  // same period: the pending expiry stays
+    ASSERT_EQ(0, sim.setConfig(good));
+    EXPECT_EQ(armed, sim.nextExpiry());
+}
+
+TEST(SimBackendTest, BurstsOverrunsAndDeadbandMatchTheDriver) {
+    simtemp::SimSensor sim(64);
+    simtemp::Config cfg{};
+    ASSERT_EQ(0, sim.getConfig(&cfg));
+    cfg.period_us = 10000;
+    cfg.burst = 10;
+    ASSERT_EQ(0, sim.setConfig(cfg));
+    simtemp::Device fast(sim), slow(sim);
+
+    // One expiry publishes the whole burst, evenly spaced up to the expiry.
+    simtemp::Sample buf[64];
+    sim.step();
+    ASSERT_EQ(10, fast.read(buf, 64, 0));
+    for (int i = 1; i < 10; ++i) {
+        EXPECT_EQ(1000000u, buf[i].timestamp_ns - buf[i - 1].timestamp_ns);
+    }
+    EXPECT_EQ(sim.now(), buf[9].timestamp_ns);
+
+    // A reader that keeps up loses nothing; one that lags gets the flag.
+    for (int i = 0; i < 10; ++i) {
+        sim.step();
+        ASSERT_EQ(10, fast.read(buf, 64, 0));
+    }
+    ASSERT_EQ(63, slow.read(buf, 64, 0));
+    EXPECT_NE(0u, buf[0].flags & SIMTEMP_FLAG_OVERRUN);
+    EXPECT_EQ(0u, buf[1].flags & SIMTEMP_FLAG_OVERRUN);
+    EXPECT_EQ(110u - 63u, slow.lost());
+    EXPECT_EQ(0u, fast.lost());
+    simtemp::Stats st{};
+    ASSERT_EQ(0, sim.getStats(&st));
+    EXPECT_EQ(47u, st.reader_overruns);
+    EXPECT_EQ(47u, st.ring_overwrites);
+
+    // Constant 25 °C behind a deadband: only the heartbeat is published.
+    cfg.mode = SIMTEMP_MODE_NORMAL;
+    cfg.period_us = 1000;
+    cfg.burst = 1;
+    cfg.deadband_mC = 500;
+    cfg.heartbeat_us = 20000;
+    ASSERT_EQ(0, sim.setConfig(cfg));
+    fast.flush();
+    simtemp::Sample prev{}, s{};
+    ASSERT_EQ(1, fast.read(&prev, 1, 1000));
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(1, fast.read(&s, 1, 1000));
+        EXPECT_EQ(20000000u, s.timestamp_ns - prev.timestamp_ns);
+        EXPECT_EQ(25000, s.temp_mC);
+        prev = s;
+    }
+    // A timed wait in the silence returns 0 after exactly that much virtual time.
+    const uint64_t before = sim.now();
+    EXPECT_EQ(0, fast.read(&s, 1, 5));
+    EXPECT_EQ(before + 5000000u, sim.now());
+    ASSERT_EQ(0, sim.getStats(&st));
+    EXPECT_GT(st.suppressed, 50u);
+}
+
+TEST(SimBackendTest, DeadbandDropsTakeNoRingSlots) {
+    simtemp::SimSensor sim(64);  // 63 usable slots
+    simtemp::Config cfg{};
+    ASSERT_EQ(0, sim.getConfig(&cfg));
+    cfg.mode = SIMTEMP_MODE_NORMAL;  // constant: everything after the first is dropped
+    cfg.period_us = 1000;
+    cfg.burst = 10;
+    cfg.deadband_mC = 500;
+    ASSERT_EQ(0, sim.setConfig(cfg));
+    simtemp::Device dev(sim);
+
+    // 200 candidates, one survivor: nothing may be pushed out or look torn.
+    for (int i = 0; i < 20; ++i)
+        sim.step();
+    simtemp::Stats st{};
+    ASSERT_EQ(0, sim.getStats(&st));
+    EXPECT_EQ(199u, st.suppressed);
+    EXPECT_EQ(0u, st.ring_overwrites);
+    EXPECT_EQ(1u, sim.ctrl()->reserve - sim.ctrl()->tail);
+
+    simtemp::Sample buf[16];
+    ASSERT_EQ(1, dev.read(buf, 16, 0));
+    EXPECT_EQ(0u, buf[0].flags & SIMTEMP_FLAG_OVERRUN);
+    EXPECT_EQ(0u, dev.lost());
+}
+
+TEST(SimBackendTest, PerfCountersCoverDeviceAndReader) {
+    simtemp::SimSensor sim(64);
+    simtemp::Config cfg{};
+    ASSERT_EQ(0, sim.getConfig(&cfg));
+    cfg.period_us = 1000;
+    cfg.burst = 16;
+    ASSERT_EQ(0, sim.setConfig(cfg));
+    simtemp::Device a(sim), b(sim);
+
+    // 64 records into 63 slots: one is overwritten before anyone reads.
+    for (int i = 0; i < 4; ++i)
+        sim.step();
+    simtemp::Sample buf[16];
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(16, a.read(buf, 16, 0));
+    }
+
+    simtemp::Perf p{};
+    ASSERT_EQ(0, a.getPerf(&p));
+    EXPECT_EQ(sim.now(), p.timestamp_ns);
+    EXPECT_EQ(64u, p.total_samples);
+    EXPECT_EQ(1u, p.ring_overwrites);
+    EXPECT_EQ(2u, p.readers);
+    EXPECT_EQ(63u, p.ring_high_water);
+    EXPECT_EQ(48u, p.delivered);
+    EXPECT_EQ(48u * sizeof(simtemp::Sample), p.bytes);
+    EXPECT_EQ(1u, p.drops);
+    EXPECT_EQ(3u, p.reads);
+
+    // The per-file half belongs to the handle asking.
+    ASSERT_EQ(0, b.getPerf(&p));
+    EXPECT_EQ(0u, p.delivered);
+    EXPECT_EQ(0u, p.reads);
+    EXPECT_EQ(63u, p.ring_high_water);
+}
+
+// The stream, flag, batch, overrun, deadband and config cases run through
+// simtemp::Device, once on a SimSensor (virtual time, always available) and
+// once per transport on /dev/simtemp (skipped without the module).
+enum class Backend { Sim, DeviceMmap, DeviceRead };
+
+class BackendTest : public ::testing::TestWithParam<Backend> {
+protected:
+    void SetUp() override {
+        if (GetParam() == Backend::Sim) {
+            sim_ = std::make_unique<simtemp::SimSensor>();
+        } else if (!PathExists(kDevPath)) {
+            GTEST_SKIP() << "/dev/simtemp not present; load module before running tests";
+        }
+        dev_ = Open();
+        if (GetParam() == Backend::DeviceMmap && !dev_->mapped()) {
+            GTEST_SKIP() << "driver does not map its ring";
+        }
+        ASSERT_EQ(0, dev_->getConfig(&saved_));
+        if (!sim_ && dev_->setConfig(saved_) != 0) {
+            GTEST_SKIP() << "Need permission to reconfigure /dev/simtemp (sudo?)";
+        }
+        restore_ = !sim_;
+    }
+
+    void TearDown() override {
+        // Restore original configuration to avoid leaking state across runs.
+        if (restore_) {
+            dev_->setConfig(saved_);
+        }
+    }
+
+    // Another reader on the same backend, with the same transport.
+    std::unique_ptr<simtemp::Device> Open() {
+        if (sim_) {
+            return std::make_unique<simtemp::Device>(*sim_);
+        }
+        return std::make_unique<simtemp::Device>(
+            "simtemp", GetParam() == Backend::DeviceRead ? simtemp::Device::Transport::Read
+                                                         : simtemp::Device::Transport::Auto);
+    }
+
+    // get, edit, set: SIMTEMP_IOC_SET_CONFIG or SimSensor::setConfig().
+    template <typename Fn>
+    int Configure(Fn&& edit) {
+        simtemp::Config cfg{};
+        const int ret = dev_->getConfig(&cfg);
+        if (ret != 0) {
+            return ret;
+        }
+        edit(cfg);
+        return dev_->setConfig(cfg);
+    }
+
+    // Lets @ms pass without reading: wall-clock on the device, virtual on the model.
+    void Let(int ms) {
+        if (sim_) {
+            sim_->advance(uint64_t(ms) * 1000000);
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        }
+    }
+
+    simtemp::Stats Stats() {
+        simtemp::Stats st{};
+        EXPECT_EQ(0, dev_->getStats(&st));
+        return st;
+    }
+
+    simtemp::Device& dev() { return *dev_; }
+
+    std::unique_ptr<simtemp::SimSensor> sim_;
+    std::unique_ptr<simtemp::Device> dev_;
+    simtemp::Config saved_{};
+    bool restore_ = false;
+};
+
+INSTANTIATE_TEST_SUITE_P(, BackendTest,
+                         ::testing::Values(Backend::Sim, Backend::DeviceMmap, Backend::DeviceRead),
+                         [](const ::testing::TestParamInfo<Backend>& info) {
+                             switch (info.param) {
+                             case Backend::Sim: return "Sim";
+                             case Backend::DeviceMmap: return "DeviceMmap";
+                             default: return "DeviceRead";
+                             }
+                         });
+
+TEST_P(BackendTest, SamplesContainExpectedFlagsAndRange) {
+    // Ramp mode should periodically generate threshold crossing events.
+    const int threshold = 30000;
+    ASSERT_EQ(0, Configure([&](simtemp::Config& c) {
+        c.mode = SIMTEMP_MODE_RAMP;
+        c.period_us = 5000;
+        c.threshold_mC = threshold;
+    }));
+
+    // Allow new configuration to take effect.
+    Let(50);
+    dev().flush();
+
+    constexpr int kSampleBudget = 600;
+    bool crossing_seen = false;
+    bool has_previous = false;
+    simtemp::Sample previous{};
+
+    for (int i = 0; i < kSampleBudget; ++i) {
+        simtemp::Sample s{};
+        ASSERT_EQ(1, dev().read(&s, 1, 200)) << "timeout waiting for sample " << i;
+        EXPECT_NE(0u, s.flags & SIMTEMP_FLAG_NEW_SAMPLE);
+        EXPECT_GE(s.temp_mC, 20000);
+        EXPECT_LE(s.temp_mC, 45000);
+        if (s.flags & SIMTEMP_FLAG_THRESHOLD) {
+            crossing_seen = true;
+            if (has_previous) {
+                // Ensure the flag corresponds to a sign change across the threshold.
+                const long long prev_delta = static_cast<long long>(previous.temp_mC) - threshold;
+                const long long curr_delta = static_cast<long long>(s.temp_mC) - threshold;
+                EXPECT_LE(prev_delta * curr_delta, 0)
+                    << "threshold flag should indicate sign change around threshold";
+            }
+            break;
+        }
+        previous = s;
+        has_previous = true;
+    }
+
+    EXPECT_TRUE(crossing_seen) << "Expected at least one threshold crossing flag in ramp mode";
+}
+
+TEST_P(BackendTest, BatchedReadReturnsSeveralRecords) {
+    // Samples that queued up while nobody read come back in one call.
+    ASSERT_EQ(0, Configure([](simtemp::Config& c) {
+        c.mode = SIMTEMP_MODE_RAMP;
+        c.period_us = 2000;
+    }));
+    dev().flush();
+    Let(100);
+
+    simtemp::Sample batch[64];
+    const ssize_t n = dev().read(batch, 64, 0);
+    ASSERT_GT(n, 1) << "expected more than one record per read()";
+    for (ssize_t i = 0; i < n; ++i) {
+        EXPECT_NE(0u, batch[i].flags & SIMTEMP_FLAG_NEW_SAMPLE);
+        if (i > 0) {
+            EXPECT_GT(batch[i].timestamp_ns, batch[i - 1].timestamp_ns)
+                << "timestamps must be monotonic within a batch";
+        }
+    }
+}
+
+TEST_P(BackendTest, EveryReaderSeesTheFullStream) {
+    // Two openers must each receive every sample instead of splitting them.
+    ASSERT_EQ(0, Configure([](simtemp::Config& c) { c.period_us = 5000; }));
+    std::unique_ptr<simtemp::Device> other = Open();
+    dev().flush();
+
+    std::vector<uint64_t> first, second;
+    // Collect from the first reader only, then catch up with the second.
+    while (first.size() < 20) {
+        simtemp::Sample s{};
+        ASSERT_EQ(1, dev().read(&s, 1, 500));
+        first.push_back(s.timestamp_ns);
+    }
+    while (second.empty() || second.back() < first.back()) {
+        simtemp::Sample s{};
+        ASSERT_EQ(1, other->read(&s, 1, 500));
+        second.push_back(s.timestamp_ns);
+    }
+
+    for (uint64_t ts : first) {
+        EXPECT_NE(second.end(), std::find(second.begin(), second.end(), ts))
+            << "sample " << ts << " was consumed by the other reader";
+    }
+}
+
+TEST_P(BackendTest, LaggingReaderGetsOverrunFlag) {
+    // Fill the ring well past its capacity without reading.
+    ASSERT_EQ(0, Configure([](simtemp::Config& c) {
+        c.period_us = 1000;
+        c.burst = 1;
+    }));
+    dev().flush();
+    const simtemp::Stats before = Stats();
+    Let(400);
+
+    simtemp::Sample s{};
+    ASSERT_EQ(1, dev().read(&s, 1, 500));
+    EXPECT_NE(0u, s.flags & SIMTEMP_FLAG_OVERRUN) << "first record after a gap should carry OVERRUN";
+
+    // The producer counts its overwrites; the loss is the consumer's to count.
+    const simtemp::Stats after = Stats();
+    EXPECT_GT(after.ring_overwrites, before.ring_overwrites);
+    if (dev().mapped()) {
+        EXPECT_GT(dev().lost(), 0u);
+    } else {
+        EXPECT_GT(after.reader_overruns, before.reader_overruns);
+    }
+
+    // Once caught up, the flag must not persist.
+    dev().flush();
+    ASSERT_EQ(1, dev().read(&s, 1, 500));
+    EXPECT_EQ(0u, s.flags & SIMTEMP_FLAG_OVERRUN);
+}
+
+TEST_P(BackendTest, BurstPublishesEvenlySpacedSamplesTogether) {
+    // 10 samples per 10 ms expiry: 1 kHz with 100 timer interrupts per second.
+    ASSERT_EQ(0, Configure([](simtemp::Config& c) {
+        c.period_us = 10000;
+        c.burst = 10;
+    }));
+    EXPECT_EQ(-EINVAL, Configure([](simtemp::Config& c) { c.burst = 0; }));
+    dev().flush();
+
+    simtemp::Sample batch[256];
+    // Woken once per burst, a waiting read sees the whole burst at once.
+    ssize_t n = dev().read(batch, 256, 500);
+    ASSERT_GE(n, 10);
+
+    std::vector<uint64_t> gaps;
+    uint64_t prev = 0;
+    for (int round = 0; round < 10; ++round) {
+        n = dev().read(batch, 256, 500);
+        ASSERT_GT(n, 0);
+        for (ssize_t i = 0; i < n; ++i) {
+            if (prev) {
+                ASSERT_GT(batch[i].timestamp_ns, prev) << "timestamps must stay monotonic";
+                gaps.push_back(batch[i].timestamp_ns - prev);
+            }
+            prev = batch[i].timestamp_ns;
+        }
+    }
+
+    ASSERT_FALSE(gaps.empty());
+    std::sort(gaps.begin(), gaps.end());
+    const uint64_t median = gaps[gaps.size() / 2];
+    EXPECT_GT(median, 800'000u) << "interpolated spacing should be ~1 ms";
+    EXPECT_LT(median, 1'200'000u);
+}
+
+TEST_P(BackendTest, DeadbandSuppressesStableSamplesWithHeartbeat) {
+    // normal mode is a constant 25 °C: only the heartbeat gets through.
+    ASSERT_EQ(0, Configure([](simtemp::Config& c) {
+        c.mode = SIMTEMP_MODE_NORMAL;
+        c.threshold_mC = 45000;
+        c.period_us = 1000;
+        c.burst = 1;
+        c.deadband_mC = 500;
+        c.heartbeat_us = 20000;
+    }));
+    EXPECT_EQ(-EINVAL, Configure([](simtemp::Config& c) { c.deadband_mC = 200000; }));
+    dev().flush();
+    const simtemp::Stats before = Stats();
+
+    simtemp::Sample prev{}, s{};
+    ASSERT_EQ(1, dev().read(&prev, 1, 500));
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(1, dev().read(&s, 1, 500));
+        const double gap_ms = (s.timestamp_ns - prev.timestamp_ns) / 1e6;
+        EXPECT_GE(gap_ms, 19.0);
+        EXPECT_LE(gap_ms, 30.0);
+        EXPECT_EQ(25000, s.temp_mC);
+        prev = s;
+    }
+    const simtemp::Stats after = Stats();
+    EXPECT_GT(after.suppressed - before.suppressed, 40u);
+
+    // With the filter off every sample is published again.
+    ASSERT_EQ(0, Configure([](simtemp::Config& c) { c.deadband_mC = 0; }));
+    dev().flush();
+    ASSERT_EQ(1, dev().read(&prev, 1, 500));
+    ASSERT_EQ(1, dev().read(&s, 1, 500));
+    EXPECT_LE((s.timestamp_ns - prev.timestamp_ns) / 1e6, 5.0);
+}
+
+TEST_P(BackendTest, ConfigIsAtomicAndKeepsTheStreamAlive) {
+    simtemp::Config next{};
+    ASSERT_EQ(0, dev().getConfig(&next));
+    next.period_us = 5000;
+    next.threshold_mC = 31000;
+    next.mode = SIMTEMP_MODE_NOISY;
+    next.burst = 2;
+    next.wakeup_watermark = 4;
+    next.wakeup_latency_us = 20000;
+    ASSERT_EQ(0, dev().setConfig(next));
+    simtemp::Config now{};
+    ASSERT_EQ(0, dev().getConfig(&now));
+    EXPECT_EQ(0, std::memcmp(&next, &now, sizeof(now)));
+
+    // One bad field rejects the whole update.
+    simtemp::Config bad = next;
+    bad.threshold_mC = 20000;
+    bad.burst = 0;
+    EXPECT_EQ(-EINVAL, dev().setConfig(bad));
+    bad = next;
+    bad.reserved[0] = 1;
+    EXPECT_EQ(-EINVAL, dev().setConfig(bad));
+    ASSERT_EQ(0, dev().getConfig(&now));
+    EXPECT_EQ(0, std::memcmp(&next, &now, sizeof(now)));
+
+    // Rapid reconfiguration keeps the stream alive.
+    for (int i = 0; i < 200; ++i) {
+        next.threshold_mC = 30000 + i;
+        ASSERT_EQ(0, dev().setConfig(next));
+    }
+    dev().flush();
+    simtemp::Sample s{};
+    EXPECT_EQ(1, dev().read(&s, 1, 500));
+}
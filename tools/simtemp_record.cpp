@@ -0,0 +1,197 @@
+// simtemp_record.cpp - record /dev/simtemp into a .stcap capture, or inspect one
+//
+//   simtemp_record -o run.stcap [-d simtemp] [--packed] [--chunk N] [--seconds S] [--count N]
+//   simtemp_record --info run.stcap
+//   simtemp_record --dump run.stcap [--from NS] [--to NS]
+//
+// Recording drains the device 4096 samples at a time through libsimtemp
+// (mmap ring when available) and stops on SIGINT/SIGTERM or the given
+// limit; the index is written on the way out.
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <getopt.h>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "simtemp_capture.h"
+#include "simtemp_client.h"
+
+namespace {
+
+volatile sig_atomic_t g_stop = 0;
+
+void onSignal(int) {
+    g_stop = 1;
+}
+
+double monoSeconds() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return double(ts.tv_sec) + ts.tv_nsec / 1e9;
+}
+
+void usage(const char* argv0) {
+    std::fprintf(stderr,
+                 "usage: %s -o FILE [-d NAME] [--packed] [--chunk N] [--seconds S] [--count N]\n"
+                 "       %s --info FILE\n"
+                 "       %s --dump FILE [--from NS] [--to NS]\n",
+                 argv0, argv0, argv0);
+}
+
+int record(const std::string& path, const std::string& name, bool packed, uint32_t chunk,
+           double seconds, uint64_t count) {
+    std::unique_ptr<simtemp::Device> dev;
+    try {
+        dev.reset(new simtemp::Device(name));
+    } catch (const std::system_error& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    simtemp::capture::Writer w;
+    int ret = w.open(path, name, chunk,
+                     packed ? simtemp::capture::CODEC_PACKED : simtemp::capture::CODEC_RAW);
+    if (ret) {
+        std::fprintf(stderr, "%s: %s\n", path.c_str(), std::strerror(-ret));
+        return 1;
+    }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    std::vector<simtemp::Sample> buf(4096);
+    uint64_t overruns = 0;
+    const double start = monoSeconds();
+    while (!g_stop) {
+        if (seconds > 0 && monoSeconds() - start >= seconds)
+            break;
+        size_t want = buf.size();
+        if (count && count - w.samples() < want)
+            want = size_t(count - w.samples());
+        const ssize_t n = dev->read(buf.data(), want, 200);
+        if (n < 0) {
+            std::fprintf(stderr, "read: %s\n", std::strerror(int(-n)));
+            break;
+        }
+        for (ssize_t i = 0; i < n; ++i)
+            overruns += (buf[i].flags & SIMTEMP_FLAG_OVERRUN) != 0;
+        if ((ret = w.append(buf.data(), size_t(n)))) {
+            std::fprintf(stderr, "%s: %s\n", path.c_str(), std::strerror(-ret));
+            break;
+        }
+        if (count && w.samples() >= count)
+            break;
+    }
+
+    ret = w.close();
+    if (ret)
+        std::fprintf(stderr, "%s: %s\n", path.c_str(), std::strerror(-ret));
+    const double elapsed = monoSeconds() - start;
+    std::printf("%llu samples in %.1f s (%.0f/s), %llu bytes (%.2f B/sample), %llu overruns%s\n",
+                (unsigned long long)w.samples(), elapsed,
+                elapsed > 0 ? w.samples() / elapsed : 0.0, (unsigned long long)w.bytes(),
+                w.samples() ? double(w.bytes()) / double(w.samples()) : 0.0,
+                (unsigned long long)overruns, dev->mapped() ? " [mmap]" : "");
+    return ret ? 1 : 0;
+}
+
+int info(const std::string& path) {
+    simtemp::capture::Reader r;
+    if (int ret = r.open(path)) {
+        std::fprintf(stderr, "%s: %s\n", path.c_str(), std::strerror(-ret));
+        return 1;
+    }
+    std::printf("device=%.16s chunks=%zu samples=%llu index=%s\n", r.header().device, r.chunks(),
+                (unsigned long long)r.samples(), r.indexed() ? "yes" : "rebuilt");
+    for (size_t i = 0; i < r.chunks(); ++i) {
+        const simtemp::capture::IndexEntry& e = r.chunk(i);
+        std::printf("%6zu  %llu..%llu  n=%u  min=%.3fC max=%.3fC%s\n", i,
+                    (unsigned long long)e.first_ns, (unsigned long long)e.last_ns, e.count,
+                    e.min_mC / 1000.0, e.max_mC / 1000.0,
+                    (e.flags_any & SIMTEMP_FLAG_THRESHOLD) ? " alert" : "");
+    }
+    return 0;
+}
+
+// Same line format as cli/simtemp_cli.py.
+int dump(const std::string& path, uint64_t from, uint64_t to) {
+    simtemp::capture::Reader r;
+    if (int ret = r.open(path)) {
+        std::fprintf(stderr, "%s: %s\n", path.c_str(), std::strerror(-ret));
+        return 1;
+    }
+    std::vector<simtemp::Sample> samples;
+    for (size_t i = r.findChunk(from); i < r.chunks() && r.chunk(i).first_ns <= to; ++i) {
+        if (r.decode(i, samples)) {
+            std::fprintf(stderr, "%s: chunk %zu is corrupt\n", path.c_str(), i);
+            return 1;
+        }
+        for (const simtemp::Sample& s : samples) {
+            if (s.timestamp_ns >= from && s.timestamp_ns <= to)
+                std::printf("%llu temp=%.3fC alert=%u\n", (unsigned long long)s.timestamp_ns,
+                            s.temp_mC / 1000.0, (s.flags & SIMTEMP_FLAG_THRESHOLD) ? 1u : 0u);
+        }
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    enum { OPT_PACKED = 256, OPT_CHUNK, OPT_SECONDS, OPT_COUNT, OPT_INFO, OPT_DUMP, OPT_FROM, OPT_TO };
+    static const struct option opts[] = {
+        { "output", required_argument, nullptr, 'o' },
+        { "device", required_argument, nullptr, 'd' },
+        { "packed", no_argument, nullptr, OPT_PACKED },
+        { "chunk", required_argument, nullptr, OPT_CHUNK },
+        { "seconds", required_argument, nullptr, OPT_SECONDS },
+        { "count", required_argument, nullptr, OPT_COUNT },
+        { "info", required_argument, nullptr, OPT_INFO },
+        { "dump", required_argument, nullptr, OPT_DUMP },
+        { "from", required_argument, nullptr, OPT_FROM },
+        { "to", required_argument, nullptr, OPT_TO },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 },
+    };
+
+    std::string output, name = "simtemp", infoPath, dumpPath;
+    bool packed = false;
+    uint32_t chunk = 65536;
+    double seconds = 0;
+    uint64_t count = 0, from = 0, to = UINT64_MAX;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "o:d:h", opts, nullptr)) != -1) {
+        switch (c) {
+        case 'o': output = optarg; break;
+        case 'd': name = optarg; break;
+        case OPT_PACKED: packed = true; break;
+        case OPT_CHUNK: chunk = uint32_t(std::strtoul(optarg, nullptr, 0)); break;
+        case OPT_SECONDS: seconds = std::strtod(optarg, nullptr); break;
+        case OPT_COUNT: count = std::strtoull(optarg, nullptr, 0); break;
+        case OPT_INFO: infoPath = optarg; break;
+        case OPT_DUMP: dumpPath = optarg; break;
+        case OPT_FROM: from = std::strtoull(optarg, nullptr, 0); break;
+        case OPT_TO: to = std::strtoull(optarg, nullptr, 0); break;
+        default:
+            usage(argv[0]);
+            return c == 'h' ? 0 : 2;
+        }
+    }
+
+    if (!infoPath.empty())
+        return info(infoPath);
+    if (!dumpPath.empty())
+        return dump(dumpPath, from, to);
+    if (output.empty() || chunk == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    return record(output, name, packed, chunk, seconds, count);
+}